@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""
+End-to-end speedup of autopar over the samples, run by `make bench`.
+
+Every sample is compiled as is (serial) and after going through autopar (parallel), both with OpenMP.
+The parallel binary is run for every AUTOPAR_LIMITER mode and OMP_NUM_THREADS, and each run must
+exit successfully and print what the serial binary printed (numbers are compared with a relative
+tolerance, since tasks may add floating-point values in another order). Runtimes, speedups and
+efficiencies are written to bench.csv and bench.json in the work directory.
+"""
+
+import argparse
+import csv
+import json
+import os
+import statistics
+import subprocess
+import sys
+import time
+
+
+def split_list(value):
+    return [item for item in value.replace(";", ",").split(",") if item]
+
+
+def default_threads():
+    cores = os.cpu_count() or 1
+    threads = [1]
+    while threads[-1] * 2 <= cores:
+        threads.append(threads[-1] * 2)
+    if threads[-1] != cores:
+        threads.append(cores)
+    return threads
+
+
+def build(command):
+    print("+ " + " ".join(command), flush=True)
+    subprocess.run(command, check=True)
+
+
+def run(binary, env):
+    start = time.perf_counter()
+    result = subprocess.run([binary], env=env, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    return time.perf_counter() - start, result
+
+
+def same_output(expected, actual, tolerance):
+    expected, actual = expected.split(), actual.split()
+    if len(expected) != len(actual):
+        return False
+
+    for a, b in zip(expected, actual):
+        if a == b:
+            continue
+        try:
+            x, y = float(a), float(b)
+        except ValueError:
+            return False
+        if abs(x - y) > tolerance * max(abs(x), abs(y)):
+            return False
+
+    return True
+
+
+def measure(binary, env, repeats, reference, tolerance):
+    """runtimes of `repeats` runs, and whether they all matched the reference output"""
+    times, correct = [], True
+    for _ in range(repeats):
+        elapsed, result = run(binary, env)
+        times.append(elapsed)
+        if result.returncode != 0 or (reference is not None and not same_output(reference, result.stdout, tolerance)):
+            correct = False
+            sys.stderr.write(result.stderr)
+    return times, correct
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("samples", nargs="+")
+    parser.add_argument("--autopar", required=True)
+    parser.add_argument("--autopar-args", default="", help="extra options of autopar, e.g. --backend=ws")
+    parser.add_argument("--runtime-include", required=True)
+    parser.add_argument("--runtime-lib", required=True)
+    parser.add_argument("--cxx", default="c++")
+    parser.add_argument("--cxx-flags", default="-O2 -std=c++17")
+    parser.add_argument("--openmp-flags", default="-fopenmp")
+    parser.add_argument("--threads", default="", help="comma-separated, powers of two up to the number of cores by default")
+    parser.add_argument("--limiters", default="NO,NOLIMIT,DEPTH,NB,BOTH")
+    parser.add_argument("--repeats", type=int, default=3)
+    parser.add_argument("--tolerance", type=float, default=1e-6)
+    parser.add_argument("--work-dir", default="bench")
+    args = parser.parse_args()
+
+    threads = [int(t) for t in split_list(args.threads)] or default_threads()
+    limiters = split_list(args.limiters)
+    flags = args.cxx_flags.split() + args.openmp_flags.split()
+    os.makedirs(args.work_dir, exist_ok=True)
+
+    rows, failed = [], False
+
+    for sample in args.samples:
+        name = os.path.splitext(os.path.basename(sample))[0]
+        serial = os.path.join(args.work_dir, name + "_serial")
+        parallel = os.path.join(args.work_dir, name + "_autopar")
+        output_dir = os.path.join(args.work_dir, name)
+
+        build([args.cxx] + flags + [sample, "-o", serial])
+        build([args.autopar] + args.autopar_args.split() + ["--output-dir=" + output_dir, sample, "--",
+                                                             "-std=c++17", "-I" + args.runtime_include])
+        build([args.cxx] + flags + ["-I" + args.runtime_include, os.path.join(output_dir, os.path.basename(sample)),
+                                    args.runtime_lib, "-o", parallel])
+
+        env = dict(os.environ)
+        _, reference = run(serial, env)
+        if reference.returncode != 0:
+            sys.exit("{}: the serial binary failed:\n{}".format(name, reference.stderr))
+
+        serial_times, _ = measure(serial, env, args.repeats, None, args.tolerance)
+        serial_median = statistics.median(serial_times)
+        rows.append({"sample": name, "limiter": "serial", "threads": 1, "median_s": serial_median,
+                     "min_s": min(serial_times), "speedup": 1.0, "efficiency": 1.0, "correct": True})
+        print("{}: serial {:.3f}s".format(name, serial_median), flush=True)
+
+        for limiter in limiters:
+            for count in threads:
+                env = dict(os.environ, OMP_NUM_THREADS=str(count), AUTOPAR_LIMITER=limiter)
+                times, correct = measure(parallel, env, args.repeats, reference.stdout, args.tolerance)
+                median = statistics.median(times)
+                speedup = serial_median / median
+                failed |= not correct
+
+                rows.append({"sample": name, "limiter": limiter, "threads": count, "median_s": median,
+                             "min_s": min(times), "speedup": speedup, "efficiency": speedup / count,
+                             "correct": correct})
+                print("{}: {} x{} {:.3f}s speedup {:.2f}{}".format(name, limiter, count, median, speedup,
+                                                                   "" if correct else " WRONG OUTPUT"), flush=True)
+
+    with open(os.path.join(args.work_dir, "bench.csv"), "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=list(rows[0].keys()))
+        writer.writeheader()
+        writer.writerows(rows)
+
+    with open(os.path.join(args.work_dir, "bench.json"), "w") as f:
+        json.dump({"repeats": args.repeats, "autopar_args": args.autopar_args, "results": rows}, f, indent=2)
+
+    print("Results written to " + os.path.join(args.work_dir, "bench.csv") + " and bench.json")
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,234 @@
+/*
+cost of the scaffolding emitted around every task, in ns per task, run by `make microbench`.
+
+The same tasks are spawned three ways: called serially, as plain OpenMP tasks, and wrapped in the
+code autopar generates (taskgroup prologue, NB counter, depth bookkeeping, if clause and the goto
+return path), which the build obtains by running autopar on the serial kernels of scaffolding_kernels.cpp.
+Flat kernels spawn every task from one thread with depend clauses of growing width on distinct
+addresses, tree kernels spawn a binary tree of tasks recursively like a divide and conquer program.
+The limiter mode is read from AUTOPAR_LIMITER once at startup, so every mode is a run.
+*/
+
+#include "scaffolding.hpp"
+
+#include <autopar_rt.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+double slots[SLOTS][8];
+double *leaves;
+thread_local double scratch;
+
+/* scaffolding_kernels.cpp, compiled as is and as transformed by autopar */
+#define AUTOPAR_BENCH_KERNELS                     \
+    void flat0(int tasks, int work);              \
+    void flat1(int tasks, int work);              \
+    void flat2(int tasks, int work);              \
+    void flat4(int tasks, int work);              \
+    void flat8(int tasks, int work);              \
+    double tree(int depth, int index, int work);
+
+namespace serial { AUTOPAR_BENCH_KERNELS }
+namespace autopar { AUTOPAR_BENCH_KERNELS }
+
+#define AUTOPAR_BENCH_DO_PRAGMA(...) _Pragma(#__VA_ARGS__)
+#define AUTOPAR_BENCH_PRAGMA(...) AUTOPAR_BENCH_DO_PRAGMA(__VA_ARGS__)
+
+static void
+flatOmp0(int tasks, int work) {
+    for (int i = 0; i < tasks; ++i) {
+        #pragma omp task default(shared)
+        {
+            touch0(work);
+        }
+    }
+    #pragma omp taskwait
+}
+
+#define AUTOPAR_BENCH_OMP_FLAT(W, DEPEND, ...)                                                         \
+static void                                                                                            \
+flatOmp##W(int tasks, int work) {                                                                      \
+    for (int i = 0; i < tasks; ++i) {                                                                  \
+        double *d = slots[i % SLOTS];                                                                  \
+        AUTOPAR_BENCH_PRAGMA(omp task DEPEND firstprivate(d) default(shared))                          \
+        {                                                                                              \
+            touch##W(__VA_ARGS__);                                                                     \
+        }                                                                                              \
+    }                                                                                                  \
+    AUTOPAR_BENCH_PRAGMA(omp taskwait)                                                                 \
+}
+
+AUTOPAR_BENCH_OMP_FLAT(1, depend(inout: d[0]), d[0], work)
+AUTOPAR_BENCH_OMP_FLAT(2, depend(inout: d[0], d[1]), d[0], d[1], work)
+AUTOPAR_BENCH_OMP_FLAT(4, depend(inout: d[0], d[1], d[2], d[3]), d[0], d[1], d[2], d[3], work)
+AUTOPAR_BENCH_OMP_FLAT(8, depend(inout: d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7]),
+                       d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7], work)
+
+static double
+treeOmp(int depth, int index, int work) {
+    if (depth == 0) {
+        leaves[index] = spin(leaves[index], work);
+        return leaves[index];
+    }
+
+    double a, b;
+    #pragma omp task depend(inout: a) default(shared)
+    {
+        a = treeOmp(depth - 1, 2 * index, work);
+    }
+    #pragma omp task depend(inout: b) default(shared)
+    {
+        b = treeOmp(depth - 1, 2 * index + 1, work);
+    }
+    #pragma omp taskwait
+    return a + b;
+}
+
+struct Kernel {
+    const char *name;
+    int depend;      /* width of the depend clauses */
+    bool parallel;   /* measured at every thread count, serial kernels only on one thread */
+    bool tree;
+    void (*flat)(int, int);
+    double (*recursive)(int, int, int);
+};
+
+static const Kernel KERNELS[] = {
+    {"flat-serial", 0, false, false, serial::flat0, nullptr},
+    {"flat-omp", 0, true, false, flatOmp0, nullptr},
+    {"flat-omp", 1, true, false, flatOmp1, nullptr},
+    {"flat-omp", 2, true, false, flatOmp2, nullptr},
+    {"flat-omp", 4, true, false, flatOmp4, nullptr},
+    {"flat-omp", 8, true, false, flatOmp8, nullptr},
+    {"flat-autopar", 0, true, false, autopar::flat0, nullptr},
+    {"flat-autopar", 1, true, false, autopar::flat1, nullptr},
+    {"flat-autopar", 2, true, false, autopar::flat2, nullptr},
+    {"flat-autopar", 4, true, false, autopar::flat4, nullptr},
+    {"flat-autopar", 8, true, false, autopar::flat8, nullptr},
+    {"tree-serial", 0, false, true, nullptr, serial::tree},
+    {"tree-omp", 1, true, true, nullptr, treeOmp},
+    {"tree-autopar", 1, true, true, nullptr, autopar::tree},
+};
+
+static double sink;
+
+/* best time of `repeats` runs of the kernel on `threads` threads, in ns per task */
+static double
+measure(const Kernel &kernel, int threads, int tasks, int depth, int work, int repeats) {
+    double best = 0;
+
+    for (int r = 0; r < repeats; ++r) {
+        double elapsed = 0;
+
+        #pragma omp parallel num_threads(threads)
+        {
+            AUTOPAR_nbdepth = 0;
+            #pragma omp barrier
+            #pragma omp master
+            {
+                double start = omp_get_wtime();
+                if (kernel.tree) {
+                    sink += kernel.recursive(depth, 1, work);
+                } else {
+                    kernel.flat(tasks, work);
+                }
+                elapsed = omp_get_wtime() - start;
+            }
+        }
+
+        if (r == 0 || elapsed < best) best = elapsed;
+    }
+
+    int count = kernel.tree ? (2 << depth) - 1 : tasks;
+    return best * 1e9 / count;
+}
+
+static std::vector<int>
+parseList(const char *value) {
+    std::vector<int> list;
+    for (const char *p = value; *p;) {
+        char *end;
+        long n = std::strtol(p, &end, 10);
+        if (end == p) break;
+        if (n > 0) list.push_back(int(n));
+        p = *end ? end + 1 : end;
+    }
+    return list;
+}
+
+int
+main(int argc, char **argv) {
+    std::vector<int> threads;
+    std::vector<int> works = {0, 100};
+    int tasks = 100000;
+    int depth = 15;
+    int repeats = 5;
+    const char *output = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value = arg.find('=') != std::string::npos ? arg.substr(arg.find('=') + 1) : "";
+
+        if (arg.rfind("--threads=", 0) == 0) threads = parseList(value.c_str());
+        else if (arg.rfind("--work=", 0) == 0) works = parseList(value.c_str());
+        else if (arg.rfind("--tasks=", 0) == 0) tasks = std::max(1, std::atoi(value.c_str()));
+        else if (arg.rfind("--depth=", 0) == 0) depth = std::max(1, std::atoi(value.c_str()));
+        else if (arg.rfind("--repeats=", 0) == 0) repeats = std::max(1, std::atoi(value.c_str()));
+        else if (arg.rfind("--output=", 0) == 0) output = argv[i] + std::strlen("--output=");
+        else {
+            std::fprintf(stderr, "usage: %s [--threads=1,2,...] [--work=0,100] [--tasks=N] [--depth=N] [--repeats=N] [--output=file.csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (threads.empty()) {
+        for (int t = 1; t <= omp_get_num_procs(); t *= 2) threads.push_back(t);
+        if (threads.back() != omp_get_num_procs()) threads.push_back(omp_get_num_procs());
+    }
+
+    std::vector<double> treeLeaves(std::size_t(2) << depth);
+    leaves = treeLeaves.data();
+
+    const char *limiter = std::getenv("AUTOPAR_LIMITER") ? std::getenv("AUTOPAR_LIMITER") : "BOTH";
+
+    /* rows of every limiter mode are appended to the same file */
+    FILE *csv = nullptr;
+    if (output) {
+        csv = std::fopen(output, "a");
+        if (!csv) {
+            std::perror(output);
+            return 1;
+        }
+        std::fseek(csv, 0, SEEK_END);
+        if (std::ftell(csv) == 0) {
+            std::fprintf(csv, "limiter,kernel,threads,depend,work,ns_per_task\n");
+        }
+    }
+
+    std::printf("%-8s %-14s %7s %6s %5s %12s\n", "limiter", "kernel", "threads", "depend", "work", "ns/task");
+
+    for (const Kernel &kernel : KERNELS) {
+        for (int work : works) {
+            for (int t : threads) {
+                if (!kernel.parallel && t != threads.front()) continue;
+
+                int count = kernel.parallel ? t : 1;
+                double ns = measure(kernel, count, tasks, depth, work, repeats);
+
+                std::printf("%-8s %-14s %7d %6d %5d %12.1f\n", limiter, kernel.name, count, kernel.depend, work, ns);
+                if (csv) {
+                    std::fprintf(csv, "%s,%s,%d,%d,%d,%.1f\n", limiter, kernel.name, count, kernel.depend, work, ns);
+                }
+            }
+        }
+    }
+
+    if (csv) std::fclose(csv);
+
+    return sink == -1;
+}
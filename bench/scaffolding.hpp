@@ -0,0 +1,62 @@
+#ifndef SCAFFOLDING_HPP
+#define SCAFFOLDING_HPP
+
+/* shared by the harness of `make microbench` and its kernels, which the build also runs through autopar */
+
+/* every flat task gets its own addresses, tasks SLOTS apart only wait for each other if they overlap in time */
+static const int SLOTS = 4096;
+extern double slots[SLOTS][8];
+
+/* one per leaf of the trees, indexed from 2^depth, so that no two leaves share memory */
+extern double *leaves;
+
+/* without addresses in its depend clause a task only writes to its thread, since tasks SLOTS apart may run at the same time */
+extern thread_local double scratch;
+
+/* a tiny task body, `work` dependent additions */
+inline double
+spin(double x, int work) {
+    for (int i = 0; i < work; ++i) {
+        x = x * 0.5 + 1;
+    }
+    return x;
+}
+
+/* the tasks of the flat kernels, by width of their depend clause: a non-const reference is an inout dependency */
+inline void
+touch0(int work) {
+    scratch = spin(scratch, work);
+}
+
+inline void
+touch1(double &d0, int work) {
+    d0 = spin(d0, work);
+}
+
+inline void
+touch2(double &d0, double &d1, int work) {
+    d0 = spin(d0, work);
+    d1 += d0;
+}
+
+inline void
+touch4(double &d0, double &d1, double &d2, double &d3, int work) {
+    d0 = spin(d0, work);
+    d1 += d0;
+    d2 += d0;
+    d3 += d0;
+}
+
+inline void
+touch8(double &d0, double &d1, double &d2, double &d3, double &d4, double &d5, double &d6, double &d7, int work) {
+    d0 = spin(d0, work);
+    d1 += d0;
+    d2 += d0;
+    d3 += d0;
+    d4 += d0;
+    d5 += d0;
+    d6 += d0;
+    d7 += d0;
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+kernels of `make microbench` in their serial form. The build compiles this file twice: as is, in the
+namespace `serial`, and as transformed by autopar, in the namespace `autopar`, so that the measured
+scaffolding is always the code autopar emits. The kernels only call the tasks: the leaves of the trees
+spin inline, since a call would become a task too
+*/
+
+#include "scaffolding.hpp"
+
+namespace AUTOPAR_BENCH_NAMESPACE {
+
+void
+flat0(int tasks, int work) {
+    for (int i = 0; i < tasks; ++i) {
+        touch0(work);
+    }
+}
+
+void
+flat1(int tasks, int work) {
+    for (int i = 0; i < tasks; ++i) {
+        double *d = slots[i % SLOTS];
+        touch1(d[0], work);
+    }
+}
+
+void
+flat2(int tasks, int work) {
+    for (int i = 0; i < tasks; ++i) {
+        double *d = slots[i % SLOTS];
+        touch2(d[0], d[1], work);
+    }
+}
+
+void
+flat4(int tasks, int work) {
+    for (int i = 0; i < tasks; ++i) {
+        double *d = slots[i % SLOTS];
+        touch4(d[0], d[1], d[2], d[3], work);
+    }
+}
+
+void
+flat8(int tasks, int work) {
+    for (int i = 0; i < tasks; ++i) {
+        double *d = slots[i % SLOTS];
+        touch8(d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7], work);
+    }
+}
+
+/* a binary tree of calls, like a divide and conquer program */
+double
+tree(int depth, int index, int work) {
+    if (depth == 0) {
+        double x = leaves[index];
+        for (int i = 0; i < work; ++i) {
+            x = x * 0.5 + 1;
+        }
+        leaves[index] = x;
+        return x;
+    }
+
+    double a = tree(depth - 1, 2 * index, work);
+    double b = tree(depth - 1, 2 * index + 1, work);
+    return a + b;
+}
+
+}
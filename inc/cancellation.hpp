@@ -0,0 +1,21 @@
+#ifndef CANCELLATION_HPP
+#define CANCELLATION_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/Stmt.h>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+/* returns of a function that may leave tasks pending, and whether those tasks can be discarded */
+struct Cancellation {
+    std::vector<const ReturnStmt *> returns;
+    bool legal = false;
+    std::string reason; /* why the pending tasks have to complete */
+};
+
+Cancellation analyzeCancellation(const FunctionDecl *, ASTContext &);
+
+#endif
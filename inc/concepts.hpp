@@ -17,17 +17,45 @@ using namespace clang;
 struct DependInfo {
     std::set<std::string> read;
     std::set<std::string> write;
+    std::string guard; /* runtime condition under which the dependencies are complete, empty if always */
+    std::string instanceGuard; /* template instantiations in which the call is a task, empty if all */
+    std::string affinity; /* main array argument of the call, empty if none */
 };
 
 struct Task {
     int id;
     DependInfo depInfo;
+    std::string callee;
+    unsigned line = 0;
+    unsigned cost = 0; /* static estimate of the callee, only computed for --task-graph */
+};
+
+/* inserted taskwait, waiting for the tasks created before it in the function */
+struct Barrier {
+    unsigned line;
+    std::size_t tasksBefore;
 };
 
 struct Function {
     int id;
     std::string name;
     std::vector<Task> tasks;
+    std::vector<Barrier> barriers;
+};
+
+struct TaskCreationStats {
+    unsigned functions = 0;
+    unsigned callSites = 0;
+    unsigned tasks = 0;
+    unsigned taskwaits = 0;
+    unsigned simdLoops = 0;
+    unsigned simdRejected = 0;
+    unsigned reusedCalls = 0;
+    unsigned decomposedCalls = 0;
+    unsigned parallelStdCalls = 0;
+    unsigned parallelStdRejected = 0;
+    unsigned cancellingReturns = 0;
+    unsigned entryPoints = 0;
 };
 
 struct Vars {
@@ -35,12 +63,15 @@ struct Vars {
     std::set<std::string> idxs;
 };
 
+const FunctionDecl *getTaskCallee(const CallExpr *);
 int countCallExprs(const Stmt *);
 bool checkTaskCreation(const Stmt *);
 DependInfo getFCallDependencies(const FunctionDecl *, const CallExpr *, const Rewriter &);
 std::string constructDependClause(const DependInfo &);
+std::string constructDependList(const DependInfo &);
 Vars extractVariables(const Expr *, const Rewriter &);
 const Stmt *getParentIfLoop(const Expr*, ASTContext &);
 const CallExpr *findCallExpr(const Stmt *);
+bool isStdVector(QualType, QualType &element);
 
 #endif
@@ -1,6 +1,8 @@
 #ifndef CONSUMERS_HPP
 #define CONSUMERS_HPP
 
+#include "devirtualization.hpp"
+#include "profiling.hpp"
 #include "visitors.hpp"
 
 #include <clang/AST/ASTConsumer.h>
@@ -15,14 +17,24 @@ class TaskCreationASTConsumer : public ASTConsumer {
 private:
     TaskCreationVisitor Visitor;
 public:
-    TaskCreationASTConsumer(Rewriter &R, ASTContext &AC) : Visitor(R, AC) {}
+    TaskCreationASTConsumer(Rewriter &R, ASTContext &AC, TaskCreationStats &stats) : Visitor(R, AC, stats) {}
 
-    bool HandleTopLevelDecl(DeclGroupRef DR) override {
-        for (auto & b : DR) {
-            Visitor.TraverseDecl(b);
-        }
+    /* the whole TU is needed up front to know every override and template instantiation */
+    void HandleTranslationUnit(ASTContext &AC) override {
+        llvm::TimeTraceScope TimeScope("TaskCreation");
+        llvm::TimeRegion Region(getPhaseTimer(Phase::TaskCreation));
 
-        return true;
+        analyzeTranslationUnit(AC);
+        Visitor.TraverseDecl(AC.getTranslationUnitDecl());
+    }
+};
+
+class SummaryASTConsumer : public ASTConsumer {
+public:
+    void HandleTranslationUnit(ASTContext &AC) override {
+        llvm::TimeTraceScope TimeScope("CollectSummaries");
+        SummaryVisitor Visitor(AC);
+        Visitor.TraverseDecl(AC.getTranslationUnitDecl());
     }
 };
 
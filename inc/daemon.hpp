@@ -0,0 +1,48 @@
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <llvm/Support/Chrono.h>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+/*
+ * Long-lived server mode: keeps one ASTUnit per source file in memory and
+ * answers line-based requests read from an input stream:
+ *   transform <file>...   reparse the file if it or a header changed on disk, then write its output
+ *   reload <file>...      drop the cached AST and parse the file from scratch
+ *   status                list the loaded files
+ *   quit
+ * Replies are single lines starting with "ok", "error" or "loaded".
+ */
+class AutoparDaemon {
+public:
+    AutoparDaemon(const tooling::CompilationDatabase &Compilations);
+
+    int run(const std::vector<std::string> &files, std::istream &in);
+
+private:
+    struct Unit {
+        std::unique_ptr<ASTUnit> AST;
+        std::map<std::string, llvm::sys::TimePoint<>> dependencies; /* files read by the parse, with their modification times */
+        std::unique_ptr<Rewriter> rewriter; /* edits of the last transform, valid until a dependency changes */
+    };
+
+    const tooling::CompilationDatabase &Compilations;
+    std::map<std::string, Unit> units;
+
+    Unit *load(const std::string &file, bool forceParse);
+    std::unique_ptr<ASTUnit> parse(const std::string &file);
+    bool reparse(Unit &unit, const std::string &file);
+    void transform(Unit &unit);
+    void handleTransform(const std::string &file, bool forceParse);
+};
+
+#endif
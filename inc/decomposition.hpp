@@ -0,0 +1,26 @@
+#ifndef DECOMPOSITION_HPP
+#define DECOMPOSITION_HPP
+
+#include "concepts.hpp"
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Expr.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <vector>
+
+using namespace clang;
+
+/* calls of an expression evaluated into temporaries by sibling tasks, before the statement using them */
+struct Decomposition {
+    const CallExpr *root = nullptr;       /* call of a user function left in the statement, if any */
+    std::vector<const CallExpr *> calls;  /* hoisted calls, in evaluation order, so arguments come first */
+    std::vector<std::vector<int>> inputs; /* hoisted calls whose value each hoisted call uses */
+    std::vector<int> finalInputs;         /* hoisted calls whose value the statement uses */
+};
+
+bool decomposeExpr(const Expr *root, const CallExpr *rootCall, Decomposition &);
+DependInfo getStatementDependencies(const Expr *root, const Decomposition &, const Rewriter &);
+void removeFunctionNames(DependInfo &, const Stmt *);
+bool isHoistableType(QualType);
+
+#endif
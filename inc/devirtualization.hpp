@@ -0,0 +1,48 @@
+#ifndef DEVIRTUALIZATION_HPP
+#define DEVIRTUALIZATION_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/Expr.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+/* what a call expression actually invokes, as far as it can be determined statically */
+struct CallTarget {
+    const FunctionDecl *callee = nullptr;               /* declaration whose parameters map to the arguments, nullptr if unresolved */
+    std::vector<const FunctionDecl *> targets;          /* every possible definition when the call is dispatched at runtime */
+    std::vector<const CXXRecordDecl *> dynamicTypes;    /* dynamic types covered by `targets`, checked at runtime when guarded */
+    std::vector<const VarDecl *> captures;              /* variables a called lambda may modify through its captures */
+    std::vector<const CallExpr *> instances;            /* copies of a dependent call in the instantiations where it is a task */
+    std::string instanceGuard;                          /* `if constexpr` condition selecting those instantiations, empty if all */
+    const Expr *object = nullptr;                       /* implicit object argument of member calls */
+    unsigned argOffset = 0;                             /* index of the first argument matching a parameter */
+    bool guarded = false;
+};
+
+/* class-hierarchy analysis of one translation unit */
+class ClassHierarchy {
+public:
+    static ClassHierarchy &get();
+
+    void build(ASTContext &);
+    std::vector<const CXXMethodDecl *> getOverriders(const CXXMethodDecl *) const;
+    std::vector<const CXXRecordDecl *> getConcreteSubclasses(const CXXRecordDecl *) const;
+
+private:
+    std::map<const CXXMethodDecl *, std::vector<const CXXMethodDecl *>> overriders;
+    std::vector<const CXXRecordDecl *> records;
+
+    void addOverrider(const CXXMethodDecl *base, const CXXMethodDecl *overrider);
+};
+
+void analyzeTranslationUnit(ASTContext &);
+bool isTaskFunction(const FunctionDecl *);
+CallTarget resolveCallTarget(const CallExpr *);
+std::string getTypeGuard(const CallTarget &, const Rewriter &);
+
+#endif
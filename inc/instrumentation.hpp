@@ -0,0 +1,19 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <string>
+#include <vector>
+
+/* a rewritten call site or inserted barrier, identified in the generated code by its index */
+struct ProbeSite {
+    std::string kind; /* "task", "taskwait" or "taskgroup" */
+    std::string callee;
+    std::string file;
+    unsigned line;
+    unsigned column;
+};
+
+std::string getInstrumentationRuntime(bool stats, bool trace);
+std::string getSiteTable(const std::vector<ProbeSite> &);
+
+#endif
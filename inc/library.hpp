@@ -0,0 +1,11 @@
+#ifndef LIBRARY_HPP
+#define LIBRARY_HPP
+
+#include <clang/AST/Decl.h>
+
+using namespace clang;
+
+/* function called by the code using the library, which has to start a team when called outside of one */
+bool isEntryPoint(const FunctionDecl *);
+
+#endif
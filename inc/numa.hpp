@@ -0,0 +1,31 @@
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/Expr.h>
+#include <clang/AST/Stmt.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <string>
+
+using namespace clang;
+
+/* allocations known to be smaller are left alone, the runtime threshold of AUTOPAR_FirstTouch */
+static const unsigned long long NUMA_MIN_BYTES = 1 << 20;
+
+/* a large allocation whose declaration is followed by a serial loop initializing its elements */
+struct FirstTouchSite {
+    enum Kind {
+        None,
+        Vector,     /* std::vector<T> v(n), its allocator is replaced */
+        Raw         /* new T[n] or malloc(bytes), touched right after the declaration */
+    } kind = None;
+    const VarDecl *var = nullptr;
+    QualType element;
+    std::string bytes;  /* size of a raw allocation */
+};
+
+FirstTouchSite findFirstTouchSite(const DeclStmt *, ASTContext &, const Rewriter &);
+std::string getAffinityLocator(const FunctionDecl *, const CallExpr *, unsigned argOffset, const Rewriter &);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <llvm/Support/CommandLine.h>
+
+extern llvm::cl::OptionCategory AutoparCategory;
+
+enum class BackendKind {
+    OpenMP,
+    WorkStealing
+};
+
+extern llvm::cl::opt<bool> DaemonMode;
+extern llvm::cl::opt<std::string> ExportReplacementsDir;
+extern llvm::cl::opt<bool> TimeTrace;
+extern llvm::cl::opt<std::string> TimeTraceFile;
+extern llvm::cl::opt<unsigned> TimeTraceGranularity;
+extern llvm::cl::opt<std::string> CollectSummariesFile;
+extern llvm::cl::opt<std::string> SummariesFile;
+extern llvm::cl::opt<bool> Instrument;
+extern llvm::cl::opt<bool> Trace;
+extern llvm::cl::opt<std::string> ProfileFile;
+extern llvm::cl::opt<unsigned> ProfileMinTaskNs;
+extern llvm::cl::opt<bool> Adaptive;
+extern llvm::cl::opt<std::string> OutputDir;
+extern llvm::cl::opt<BackendKind> Backend;
+extern llvm::cl::opt<bool> Numa;
+extern llvm::cl::opt<bool> Simd;
+extern llvm::cl::opt<bool> Soa;
+extern llvm::cl::opt<std::string> TaskGraphDir;
+extern llvm::cl::opt<bool> Memoize;
+extern llvm::cl::opt<unsigned> MemoizeMinCost;
+extern llvm::cl::opt<bool> EarlySpawn;
+extern llvm::cl::opt<bool> ParallelStd;
+extern llvm::cl::opt<unsigned> ParallelStdMinSize;
+extern llvm::cl::opt<bool> Cancel;
+extern llvm::cl::opt<bool> Library;
+extern llvm::cl::list<std::string> EntryPoints;
+
+#endif
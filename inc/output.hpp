@@ -0,0 +1,17 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+
+using namespace clang;
+
+std::string getOutputPath(StringRef mainFile);
+std::string getOutputPrologue();
+bool emitParallelizedFile(const Rewriter &, llvm::raw_ostream &);
+bool writeParallelizedFile(const Rewriter &);
+bool writeOutput(const Rewriter &);
+
+#endif
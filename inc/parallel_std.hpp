@@ -0,0 +1,20 @@
+#ifndef PARALLEL_STD_HPP
+#define PARALLEL_STD_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Expr.h>
+#include <string>
+
+using namespace clang;
+
+/* a call of a standard algorithm that has a task-parallel version in the runtime */
+struct StdAlgorithmCall {
+    std::string algorithm;   /* qualified name, empty if the call isn't one of the algorithms */
+    std::string replacement; /* runtime function replacing it */
+    bool legal = false;
+    std::string reason;      /* why the call stays serial */
+};
+
+StdAlgorithmCall analyzeStdAlgorithmCall(const CallExpr *, ASTContext &);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef PROFILING_HPP
+#define PROFILING_HPP
+
+#include "concepts.hpp"
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/Timer.h>
+
+enum class Phase {
+    Frontend,
+    TaskCreation,
+    Output
+};
+
+void startProfiling(llvm::StringRef procName);
+void finishProfiling();
+llvm::Timer *getPhaseTimer(Phase);
+void printSummary(llvm::StringRef file, const TaskCreationStats &);
+
+#endif
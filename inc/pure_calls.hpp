@@ -0,0 +1,29 @@
+#ifndef PURE_CALLS_HPP
+#define PURE_CALLS_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/Expr.h>
+#include <clang/AST/Stmt.h>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+/* declaration initialized by a call to a pure function whose arguments only read local scalars */
+struct PureCall {
+    const FunctionDecl *callee;
+    std::vector<std::string> args;  /* source text of the arguments */
+    std::vector<const VarDecl *> vars; /* variables read by the arguments */
+    const VarDecl *result;
+    const DeclStmt *decl;
+};
+
+bool getPureCall(const FunctionDecl *callee, const CallExpr *, const VarDecl *result, const DeclStmt *, ASTContext &, PureCall &);
+const PureCall *findReusableCall(const std::vector<PureCall> &earlier, const PureCall &, const FunctionDecl *function, ASTContext &);
+std::string getPureCallText(const PureCall &);
+
+bool canMemoize(const FunctionDecl *, ASTContext &);
+std::string getMemoPrologue(const FunctionDecl *, ASTContext &);
+
+#endif
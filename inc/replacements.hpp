@@ -0,0 +1,11 @@
+#ifndef REPLACEMENTS_HPP
+#define REPLACEMENTS_HPP
+
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <llvm/ADT/StringRef.h>
+
+using namespace clang;
+
+bool exportReplacements(const Rewriter &, StringRef directory);
+
+#endif
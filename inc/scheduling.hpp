@@ -0,0 +1,17 @@
+#ifndef SCHEDULING_HPP
+#define SCHEDULING_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Stmt.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <vector>
+
+using namespace clang;
+
+const Stmt *getBlockStatement(const Stmt *, ASTContext &);
+
+/* moves the statements creating tasks above the earlier statements of their block they don't depend on */
+void spawnEarly(const std::vector<const Stmt *> &spawns, const std::vector<SourceLocation> &barriers, ASTContext &, Rewriter &);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Expr.h>
+#include <clang/AST/Stmt.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+/* a location updated by every iteration with one associative operator */
+struct SimdReduction {
+    std::string op;                     /* + or * */
+    std::string target;                 /* text of the reduced lvalue */
+    std::string type;                   /* type of its private copies */
+    bool variable = false;              /* target can be named in a reduction clause, otherwise it is accumulated in a local */
+    std::vector<const Expr *> updates;  /* left-hand sides of the compound assignments to the target */
+};
+
+/* outcome of the vectorization-legality analysis of an innermost loop */
+struct SimdLoop {
+    bool legal = false;
+    std::string reason;                 /* why the loop was rejected */
+    std::vector<SimdReduction> reductions;
+    unsigned safelen = 0;               /* smallest dependence distance, 0 if there is none */
+    std::vector<std::string> aligned;   /* `array: bytes` of over-aligned arrays */
+    std::vector<std::string> assumptions;
+};
+
+bool isInnermostLoop(const ForStmt *);
+SourceLocation getLoopEnd(const ForStmt *, ASTContext &);
+SimdLoop analyzeSimdLoop(const ForStmt *, ASTContext &, const Rewriter &);
+
+#endif
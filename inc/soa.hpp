@@ -0,0 +1,12 @@
+#ifndef SOA_HPP
+#define SOA_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+
+using namespace clang;
+
+/* rewrites the std::vector<T> members whose elements are accessed field by field in loops into structures of arrays */
+void convertToSoA(ASTContext &, Rewriter &);
+
+#endif
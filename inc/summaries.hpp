@@ -0,0 +1,50 @@
+#ifndef SUMMARIES_HPP
+#define SUMMARIES_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <llvm/ADT/StringRef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+enum class ParamEffect {
+    None,
+    Read,
+    Write
+};
+
+/* what a call to a function does to its arguments, usable without the function body */
+struct FunctionSummary {
+    std::string usr;
+    std::string name;
+    std::vector<ParamEffect> params;
+    unsigned cost = 0;
+    bool pure = false;
+};
+
+class SummaryIndex {
+public:
+    static SummaryIndex &get();
+
+    bool load(StringRef path);
+    bool save(StringRef path) const;
+    void add(FunctionSummary summary);
+    const FunctionSummary *lookup(const FunctionDecl *) const;
+    bool empty() const { return summaries.empty(); }
+
+private:
+    std::map<std::string, FunctionSummary> summaries;
+};
+
+std::string getUSR(const Decl *);
+FunctionSummary computeFunctionSummary(const FunctionDecl *, ASTContext &);
+bool isPureFunction(const FunctionDecl *, ASTContext &);
+bool isPureBody(const FunctionDecl *, ASTContext &);
+ParamEffect getParameterEffect(const FunctionDecl *, unsigned index, ASTContext &);
+bool isPureLibraryFunction(const FunctionDecl *, ASTContext &);
+unsigned estimateCost(const FunctionDecl *, ASTContext &);
+
+#endif
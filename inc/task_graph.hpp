@@ -0,0 +1,42 @@
+#ifndef TASK_GRAPH_HPP
+#define TASK_GRAPH_HPP
+
+#include "concepts.hpp"
+
+#include <llvm/ADT/StringRef.h>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+/* static DAG of the tasks created by one taskgroup function, with its inserted taskwaits */
+struct TaskGraph {
+    struct Node {
+        enum Kind {
+            Call,   /* a task */
+            Wait,   /* an inserted taskwait */
+            End     /* the end of the taskgroup */
+        } kind;
+        std::string label;
+        unsigned line = 0;
+        uint64_t cost = 0;
+    };
+
+    struct Edge {
+        int from;
+        int to;
+        std::string vars; /* variables of a depend edge, empty when ordered by a barrier */
+    };
+
+    std::string function;
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    uint64_t work = 0;
+    uint64_t span = 0;
+    std::vector<int> criticalPath; /* nodes, from the first task to the end */
+};
+
+TaskGraph buildTaskGraph(const Function &);
+bool writeTaskGraphs(StringRef mainFile, const std::vector<Function> &);
+
+#endif
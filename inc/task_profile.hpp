@@ -0,0 +1,49 @@
+#ifndef TASK_PROFILE_HPP
+#define TASK_PROFILE_HPP
+
+#include <clang/Basic/LLVM.h>
+#include <llvm/ADT/StringRef.h>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace clang;
+
+/* what an instrumented run recorded for one task site */
+struct SiteProfile {
+    std::string callee;
+    std::string file;
+    unsigned line = 0;
+    unsigned column = 0;
+    unsigned long long created = 0;
+    unsigned long long inlined = 0;
+    std::vector<std::pair<unsigned long long, double>> depths; /* executions and total ns, per spawning depth */
+};
+
+struct SiteDecision {
+    enum Kind {
+        Taskify,    /* keep the limiter alone */
+        Cutoff,     /* only create tasks below `depth` */
+        Serialize   /* never worth a task */
+    } kind = Taskify;
+    unsigned depth = 0;
+};
+
+class TaskProfile {
+public:
+    static TaskProfile &get();
+
+    bool load(StringRef path);
+    const SiteProfile *lookup(StringRef file, unsigned line, unsigned column) const;
+
+private:
+    std::map<std::tuple<std::string, unsigned, unsigned>, SiteProfile> sites;
+};
+
+SiteDecision decideSite(const SiteProfile &, double minTaskNs);
+
+/* the absolute path under which a site is recorded and looked up */
+std::string getSitePath(StringRef file);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef TEMPLATES_HPP
+#define TEMPLATES_HPP
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/Expr.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace clang;
+
+/* a call of a template instantiation, along with the instantiated function containing it */
+struct InstantiatedCall {
+    const CallExpr *call;
+    const FunctionDecl *function;
+};
+
+/* maps the calls of template patterns to their copies in every instantiation of one translation unit */
+class InstantiationIndex {
+public:
+    static InstantiationIndex &get();
+
+    void build(ASTContext &);
+    const std::vector<InstantiatedCall> *lookup(const CallExpr *) const;
+
+private:
+    std::map<std::pair<unsigned, unsigned>, std::vector<InstantiatedCall>> calls;
+};
+
+std::string getInstantiationGuard(const std::vector<const FunctionDecl *> &tasks,
+                                  const std::vector<const FunctionDecl *> &serial);
+
+#endif
@@ -3,11 +3,13 @@
 
 #include <llvm-18/llvm/Support/Casting.h>
 #include <llvm-18/llvm/Support/raw_ostream.h>
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <clang/AST/ASTContext.h>
 #include <clang/AST/Decl.h>
 #include <clang/AST/Expr.h>
+#include <clang/AST/ParentMapContext.h>
 #include <clang/AST/PrettyPrinter.h>
 #include <clang/AST/RecursiveASTVisitor.h>
 #include <clang/AST/Stmt.h>
@@ -17,76 +19,159 @@
 #include <clang/Lex/Lexer.h>
 #include <clang/Rewrite/Core/Rewriter.h>
 #include <clang/Basic/SourceManager.h>
+#include <llvm/Support/TimeProfiler.h>
 
+#include "cancellation.hpp"
 #include "concepts.hpp"
+#include "decomposition.hpp"
+#include "instrumentation.hpp"
+#include "library.hpp"
+#include "numa.hpp"
+#include "options.hpp"
+#include "parallel_std.hpp"
+#include "pure_calls.hpp"
+#include "scheduling.hpp"
+#include "simd.hpp"
+#include "soa.hpp"
+#include "summaries.hpp"
+#include "task_graph.hpp"
+#include "task_profile.hpp"
 
-static const std::string AUTOPAR_TASK_CLAUSE = "firstprivate(AUTOPAR_lnbdepth) if(AUTOPAR_createtaskdepth || AUTOPAR_createtasknbr) default(shared)";
+static const std::string AUTOPAR_TASK_CONDITION = "AUTOPAR_createtaskdepth || AUTOPAR_createtasknbr";
 
-static const std::string AUTOPAR_TASK_LIMITER_CODE_TASKGROUP = R"(bool AUTOPAR_createtasknbr =
-(AUTOPAR_currentLimiter != AUTOPAR_TASK_LIMITER_NO
-    && (AUTOPAR_currentLimiter == AUTOPAR_TASK_NO_LIMIT
-        || ((AUTOPAR_currentLimiter & AUTOPAR_TASK_LIMITER_NB)
-            && (AUTOPAR_nbtask<AUTOPAR_maxtask)
-		)
-    )
-);
+static const std::string AUTOPAR_TASK_PROLOGUE = "if (AUTOPAR_createtaskdepth || AUTOPAR_createtasknbr) {\n\tAUTOPAR_nbdepth=AUTOPAR_lnbdepth+1;\n}\n\n";
+
+static const std::string AUTOPAR_TASK_EPILOGUE = "\n\nif (AUTOPAR_createtasknbr) {\n\tAUTOPAR_TaskDone();\n}\n";
+
+/* admission is decided once per call of a taskgroup function, AUTOPAR_maxtask/maxdepth may be shadowed by tuned limits */
+static const std::string AUTOPAR_TASK_LIMITER_CODE_TASKGROUP = R"(bool AUTOPAR_createtasknbr = AUTOPAR_AdmitNb(AUTOPAR_maxtask);
 
 int AUTOPAR_lnbdepth = AUTOPAR_nbdepth;
 
-bool AUTOPAR_createtaskdepth =
-(AUTOPAR_currentLimiter != AUTOPAR_TASK_LIMITER_NO
-	&& (AUTOPAR_currentLimiter == AUTOPAR_TASK_NO_LIMIT
-	   || ((AUTOPAR_currentLimiter & AUTOPAR_TASK_LIMITER_DEPTH)
-		   && (AUTOPAR_lnbdepth<AUTOPAR_maxdepth)
-	   )
-    )
-);
+bool AUTOPAR_createtaskdepth = AUTOPAR_AdmitDepth(AUTOPAR_lnbdepth, AUTOPAR_maxdepth);
 )";
 
 static const std::string AUTOPAR_PRE_TASK = R"(
 if(AUTOPAR_createtasknbr){
-	#pragma omp atomic
-	AUTOPAR_nbtask++;
+	AUTOPAR_TaskSpawned();
 })";
 
+/* the tasks of a function that cancels its taskgroup count whether they started, since discarded tasks don't run */
+static const std::string AUTOPAR_PRE_CANCELLABLE_TASK = R"(
+if(AUTOPAR_createtasknbr){
+	AUTOPAR_TaskSpawned();
+	AUTOPAR_cgroup.spawned();
+})";
+
+static const std::string AUTOPAR_TASK_CANCELLATION_POINT = "#pragma omp cancellation point taskgroup\nif (AUTOPAR_createtasknbr) {\n\tAUTOPAR_cgroup.started();\n}\n";
+
+
+/* how one call site is turned into a task */
+struct TaskPlan {
+    DependInfo depInfo;
+    std::string condition; /* if clause of the task */
+    std::string affinity;  /* affinity clause, empty if none */
+    int site = -1;         /* probe site, -1 when not instrumented */
+    bool serial = false;   /* the call is left untouched */
+};
+
 
 class TaskCreationVisitor : public RecursiveASTVisitor<TaskCreationVisitor> {
 public:
-    TaskCreationVisitor(Rewriter &RW, ASTContext &AC) 
+    TaskCreationVisitor(Rewriter &RW, ASTContext &AC, TaskCreationStats &stats)
         : RW(RW)
         , AC(AC)
+        , stats(stats)
         , MainFileId(AC.getSourceManager().getMainFileID()) {
         ignoreCalls = 0;
         funcId = 0;
         taskId = 0;
+        simdAccumulators = 0;
+        tmpId = 0;
     }
 
     bool TraverseCallExpr(CallExpr *FCall) {
         return VisitCallExpr(FCall);
     }
 
+    bool TraverseTranslationUnitDecl(TranslationUnitDecl *TU) {
+        if (Soa) {
+            convertToSoA(AC, RW);
+        }
+
+        bool res = RecursiveASTVisitor::TraverseTranslationUnitDecl(TU);
+
+        if (isInstrumented()) {
+            RW.InsertText(AC.getSourceManager().getLocForEndOfFile(MainFileId), getSiteTable(sites), true, true);
+        }
+
+        if (EarlySpawn) {
+            spawnEarly(spawns, barriers, AC, RW);
+        }
+
+        if (!TaskGraphDir.empty()) {
+            writeTaskGraphs(AC.getSourceManager().getFileEntryForID(MainFileId)->getName(), functions);
+        }
+
+        return res;
+    }
+
     bool VisitDeclStmt(DeclStmt *DeclStat);
     bool VisitCallExpr(CallExpr *FCall);
     bool VisitFunctionDecl(FunctionDecl *f);
     bool VisitExpr(Expr *e);
     bool VisitReturnStmt(ReturnStmt *ret);
+    bool VisitForStmt(ForStmt *loop);
 
 private:
     int ignoreCalls;
     std::set<std::string> awaited;
     int funcId;
     int taskId;
+    int simdAccumulators;
+    int tmpId;
     std::vector<Function> functions;
     Rewriter &RW;
     ASTContext &AC;
+    TaskCreationStats &stats;
     FunctionDecl *currentFunction;
     FileID MainFileId;
+    std::vector<ProbeSite> sites;
+    std::vector<PureCall> pureCalls;
+    bool memoized = false;
+    bool cancellable = false;
+    std::set<const ReturnStmt *> cancellingReturns;
+    std::set<std::string> slots; /* result slots declared at the start of the current function */
+    std::set<std::string> waitFor;
+    std::vector<const Stmt *> decomposed;
+    std::vector<const Stmt *> spawns;
+    std::vector<SourceLocation> barriers;
 
     void addFunction(std::string funcName);
-    void addTask(DependInfo depInfo);
+    void addTask(DependInfo depInfo, const FunctionDecl *callee, const CallExpr *FCall);
     bool shouldAddTaskWait(const DependInfo& depInfo);
     bool shouldAddTaskWait(const Vars& vars);
-
+    bool conflictsWithTasks(const DependInfo& depInfo);
+    void placeFirstTouch(DeclStmt *DeclStat);
+    const DeclStmt *getSlotScope(const VarDecl *var);
+    bool canDeclareResultSlot(const VarDecl *var);
+    std::string declareResultSlot(const VarDecl *var, std::string value = "");
+    bool decomposeCalls(Stmt *stmt, Expr *root, const VarDecl *var);
+    bool isDecomposed(const Stmt *s);
+    void addSpawn(const Stmt *s);
+    void parallelizeStdCall(const CallExpr *FCall);
+    bool reusePureCall(const PureCall &earlier, const VarDecl *var, DeclStmt *DeclStat, const CallExpr *FCall);
+    TaskPlan planTask(const DependInfo &depInfo, const CallExpr *FCall);
+    std::string taskBegin(const TaskPlan &plan);
+    std::string taskEnd(const TaskPlan &plan, const std::string &serialText);
+    std::string taskWait(SourceLocation loc);
+    bool isDeclaredBefore(const std::set<std::string> &names, const Stmt *s, SourceLocation loc);
+    int addSite(const std::string &kind, const std::string &callee, SourceLocation loc);
+
+
+    bool isInstrumented() const {
+        return Instrument || Trace;
+    }
 
     bool isFromMainFile(SourceLocation loc) {
        return AC.getSourceManager().isInMainFile(loc);
@@ -94,4 +179,14 @@ private:
 
 };
 
+class SummaryVisitor : public RecursiveASTVisitor<SummaryVisitor> {
+public:
+    SummaryVisitor(ASTContext &AC) : AC(AC) {}
+
+    bool VisitFunctionDecl(FunctionDecl *f);
+
+private:
+    ASTContext &AC;
+};
+
 #endif
@@ -0,0 +1,317 @@
+#include "autopar_rt.hpp"
+
+#include <mutex>
+#include <string>
+#include <unistd.h>
+
+static AUTOPAR_TASK_LIMITER
+AUTOPAR_Limiter() {
+    if (const char* env_p = std::getenv("AUTOPAR_LIMITER")) {
+        std::string AUTOPAR_cl = env_p;
+        if (AUTOPAR_cl == "NO") return AUTOPAR_TASK_LIMITER_NO;
+        if (AUTOPAR_cl == "NOLIMIT") return AUTOPAR_TASK_NO_LIMIT;
+        if (AUTOPAR_cl == "DEPTH") return AUTOPAR_TASK_LIMITER_DEPTH;
+        if (AUTOPAR_cl == "NB") return AUTOPAR_TASK_LIMITER_NB;
+        if (AUTOPAR_cl == "BOTH") return AUTOPAR_TASK_LIMITER_BOTH;
+    }
+    return AUTOPAR_TASK_LIMITER_BOTH;
+}
+
+static int
+AUTOPAR_MaxNbTasks() {
+    if (const char* env_p = std::getenv("AUTOPAR_MAX_NB_TASKS")) {
+        return std::atoi(env_p);
+    }
+    return omp_get_max_threads() * 10;
+}
+
+static int
+AUTOPAR_MaxDepth() {
+    if (const char* env_p = std::getenv("AUTOPAR_MAX_DEPTH")) {
+        return std::atoi(env_p);
+    }
+    return 5;
+}
+
+const int AUTOPAR_currentLimiter = AUTOPAR_Limiter();
+const int AUTOPAR_maxtask = AUTOPAR_MaxNbTasks();
+const int AUTOPAR_maxdepth = AUTOPAR_MaxDepth();
+
+std::atomic<int> AUTOPAR_nbtask{0};
+thread_local int AUTOPAR_nbdepth = 0;
+
+/* one write per page, in contiguous chunks so that neighbouring pages end up on the same node */
+void
+AUTOPAR_FirstTouch(void *data, std::size_t bytes) {
+    if (!data || bytes < AUTOPAR_FIRST_TOUCH_MIN_BYTES) return;
+
+    volatile char *pages = static_cast<char *>(data);
+    long page = sysconf(_SC_PAGESIZE);
+    long nbPages = (long) ((bytes + page - 1) / page);
+
+    /* the generated main runs in the master thread of a parallel region, whose team takes the chunks as tasks */
+    if (omp_in_parallel()) {
+#pragma omp taskloop num_tasks(omp_get_num_threads())
+        for (long i = 0; i < nbPages; ++i) {
+            pages[i * page] = 0;
+        }
+    } else {
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < nbPages; ++i) {
+            pages[i * page] = 0;
+        }
+    }
+}
+
+/* converts ticks to nanoseconds with the rate measured since its construction */
+struct AUTOPAR_Clock {
+    unsigned long long startTicks = AUTOPAR_Ticks();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    double nsPerTick() const {
+        double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        unsigned long long elapsedTicks = AUTOPAR_Ticks() - startTicks;
+        return elapsedTicks ? elapsedNs / elapsedTicks : 0.0;
+    }
+};
+
+/* the site tables of every output file, in registration order. A probe registers the sites of its file before it starts timing */
+struct AUTOPAR_Sites {
+    std::mutex lock;
+    std::vector<AUTOPAR_Site> sites;
+    AUTOPAR_Clock clock;
+};
+
+static AUTOPAR_Sites &
+AUTOPAR_GetSites() {
+    static AUTOPAR_Sites sites;
+    return sites;
+}
+
+int
+AUTOPAR_RegisterSites(const AUTOPAR_Site *sites, int count) {
+    AUTOPAR_Sites &global = AUTOPAR_GetSites();
+    std::lock_guard<std::mutex> guard(global.lock);
+
+    int base = (int) global.sites.size();
+    global.sites.insert(global.sites.end(), sites, sites + count);
+    return base;
+}
+
+static void
+AUTOPAR_WriteJsonString(std::FILE *out, const char *str) {
+    std::fputc('"', out);
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') std::fputc('\\', out);
+        std::fputc(*str, out);
+    }
+    std::fputc('"', out);
+}
+
+#define AUTOPAR_PROFILE_DEPTHS 16
+
+struct AUTOPAR_SiteStats {
+    unsigned long long created;
+    unsigned long long inlined;
+    unsigned long long executed;
+    unsigned long long bodyTicks;
+    unsigned long long waits;
+    unsigned long long waitTicks;
+    unsigned long long depthCount[AUTOPAR_PROFILE_DEPTHS];
+    unsigned long long depthTicks[AUTOPAR_PROFILE_DEPTHS];
+};
+
+/* constructed by the first counted probe, after the sites of its file were registered, so it is destroyed first */
+struct AUTOPAR_Stats {
+    std::mutex lock;
+    std::vector<std::vector<AUTOPAR_SiteStats> *> threads;
+
+    ~AUTOPAR_Stats() {
+        const std::vector<AUTOPAR_Site> &sites = AUTOPAR_GetSites().sites;
+        std::vector<AUTOPAR_SiteStats> totals(sites.size());
+
+        for (size_t i = 0; i < totals.size(); ++i) {
+            AUTOPAR_SiteStats &total = totals[i];
+            for (const std::vector<AUTOPAR_SiteStats> *thread : threads) {
+                if (i >= thread->size()) continue;
+
+                const AUTOPAR_SiteStats &stats = (*thread)[i];
+                total.created += stats.created;
+                total.inlined += stats.inlined;
+                total.executed += stats.executed;
+                total.bodyTicks += stats.bodyTicks;
+                total.waits += stats.waits;
+                total.waitTicks += stats.waitTicks;
+                for (int depth = 0; depth < AUTOPAR_PROFILE_DEPTHS; ++depth) {
+                    total.depthCount[depth] += stats.depthCount[depth];
+                    total.depthTicks[depth] += stats.depthTicks[depth];
+                }
+            }
+        }
+
+        double nsPerTick = AUTOPAR_GetSites().clock.nsPerTick();
+
+        if (std::getenv("AUTOPAR_STATS")) {
+            report(sites, totals, nsPerTick / 1e6);
+        }
+
+        if (const char *path = std::getenv("AUTOPAR_PROFILE")) {
+            writeProfile(path, sites, totals, nsPerTick);
+        }
+    }
+
+    void report(const std::vector<AUTOPAR_Site> &sites, const std::vector<AUTOPAR_SiteStats> &totals, double msPerTick) {
+        std::fprintf(stderr, "\nautopar statistics (%zu threads)\n", threads.size());
+        std::fprintf(stderr, "%-5s %-32s %-9s %-24s %10s %10s %12s %10s %12s\n",
+                     "site", "location", "kind", "callee", "created", "inlined", "body (ms)", "waits", "wait (ms)");
+
+        for (size_t i = 0; i < totals.size(); ++i) {
+            const AUTOPAR_SiteStats &total = totals[i];
+            char location[4096];
+            std::snprintf(location, sizeof(location), "%s:%d:%d", sites[i].file, sites[i].line, sites[i].column);
+            std::fprintf(stderr, "%-5zu %-32s %-9s %-24s %10llu %10llu %12.3f %10llu %12.3f\n",
+                         i, location, sites[i].kind, sites[i].callee, total.created, total.inlined,
+                         total.bodyTicks * msPerTick, total.waits, total.waitTicks * msPerTick);
+        }
+    }
+
+    /* input of autopar --profile, task durations are kept per depth of the spawning task */
+    void writeProfile(const char *path, const std::vector<AUTOPAR_Site> &sites, const std::vector<AUTOPAR_SiteStats> &totals, double nsPerTick) {
+        std::FILE *out = std::fopen(path, "w");
+        if (!out) return;
+
+        std::fprintf(out, "{\"sites\":[");
+        for (size_t i = 0; i < totals.size(); ++i) {
+            const AUTOPAR_SiteStats &total = totals[i];
+            std::fprintf(out, "%s\n{\"kind\":\"%s\",\"callee\":", i ? "," : "", sites[i].kind);
+            AUTOPAR_WriteJsonString(out, sites[i].callee);
+            std::fprintf(out, ",\"file\":");
+            AUTOPAR_WriteJsonString(out, sites[i].file);
+            std::fprintf(out, ",\"line\":%d,\"column\":%d,\"created\":%llu,\"inlined\":%llu,\"depths\":[",
+                         sites[i].line, sites[i].column, total.created, total.inlined);
+            for (int depth = 0; depth < AUTOPAR_PROFILE_DEPTHS; ++depth) {
+                std::fprintf(out, "%s[%llu,%.0f]", depth ? "," : "", total.depthCount[depth], total.depthTicks[depth] * nsPerTick);
+            }
+            std::fprintf(out, "]}");
+        }
+        std::fprintf(out, "\n]}\n");
+        std::fclose(out);
+    }
+};
+
+/* grows with the sites, since a file registers its table on its first probe */
+static AUTOPAR_SiteStats &
+AUTOPAR_ThreadStats(int site) {
+    static thread_local std::vector<AUTOPAR_SiteStats> *stats = nullptr;
+    static AUTOPAR_Stats global;
+
+    if (!stats) {
+        stats = new std::vector<AUTOPAR_SiteStats>();
+
+        std::lock_guard<std::mutex> guard(global.lock);
+        global.threads.push_back(stats);
+    }
+    if ((size_t) site >= stats->size()) {
+        stats->resize(site + 1);
+    }
+
+    return (*stats)[site];
+}
+
+void
+AUTOPAR_CountSpawn(int site, bool created) {
+    AUTOPAR_SiteStats &stats = AUTOPAR_ThreadStats(site);
+    if (created) {
+        stats.created++;
+    } else {
+        stats.inlined++;
+    }
+}
+
+void
+AUTOPAR_CountProbe(int site, unsigned long long start, unsigned long long end, bool wait, int depth) {
+    AUTOPAR_SiteStats &stats = AUTOPAR_ThreadStats(site);
+    if (wait) {
+        stats.waits++;
+        stats.waitTicks += end - start;
+    } else {
+        int bucket = depth < AUTOPAR_PROFILE_DEPTHS ? depth : AUTOPAR_PROFILE_DEPTHS - 1;
+        stats.executed++;
+        stats.bodyTicks += end - start;
+        stats.depthCount[bucket]++;
+        stats.depthTicks[bucket] += end - start;
+    }
+}
+
+struct AUTOPAR_TraceEvent {
+    unsigned long long start;
+    unsigned long long end;
+    int site;
+};
+
+/* single-writer ring buffer, the oldest events are overwritten when it is full */
+struct AUTOPAR_TraceBuffer {
+    AUTOPAR_TraceEvent *events;
+    unsigned long long capacity;
+    unsigned long long count;
+    int thread;
+};
+
+struct AUTOPAR_Trace {
+    std::mutex lock;
+    std::vector<AUTOPAR_TraceBuffer *> threads;
+
+    /* Chrome trace-event JSON, one complete event per probe */
+    ~AUTOPAR_Trace() {
+        const char *path = std::getenv("AUTOPAR_TRACE");
+        std::FILE *out = std::fopen(path ? path : "autopar-trace.json", "w");
+        if (!out) return;
+
+        const std::vector<AUTOPAR_Site> &sites = AUTOPAR_GetSites().sites;
+        double usPerTick = AUTOPAR_GetSites().clock.nsPerTick() / 1e3;
+        bool first = true;
+
+        std::fprintf(out, "{\"traceEvents\":[\n");
+        for (const AUTOPAR_TraceBuffer *buffer : threads) {
+            std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"omp thread %d\"}}",
+                         first ? "" : ",\n", buffer->thread, buffer->thread);
+            first = false;
+
+            unsigned long long begin = buffer->count > buffer->capacity ? buffer->count - buffer->capacity : 0;
+            for (unsigned long long i = begin; i < buffer->count; ++i) {
+                const AUTOPAR_TraceEvent &event = buffer->events[i % buffer->capacity];
+                const AUTOPAR_Site &site = sites[event.site];
+
+                std::fprintf(out, ",\n{\"name\":");
+                AUTOPAR_WriteJsonString(out, site.callee[0] ? site.callee : site.kind);
+                std::fprintf(out, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"site\":%d,\"location\":",
+                             site.kind, buffer->thread, (event.start - AUTOPAR_GetSites().clock.startTicks) * usPerTick,
+                             (event.end - event.start) * usPerTick, event.site);
+                AUTOPAR_WriteJsonString(out, site.file);
+                std::fprintf(out, ",\"line\":%d,\"column\":%d}}", site.line, site.column);
+            }
+        }
+        std::fprintf(out, "\n]}\n");
+        std::fclose(out);
+    }
+};
+
+void
+AUTOPAR_TraceProbe(int site, unsigned long long start, unsigned long long end, int thread) {
+    static thread_local AUTOPAR_TraceBuffer *buffer = nullptr;
+    static AUTOPAR_Trace global;
+
+    if (!buffer) {
+        const char *env = std::getenv("AUTOPAR_TRACE_EVENTS");
+
+        buffer = new AUTOPAR_TraceBuffer();
+        buffer->capacity = env && std::atoll(env) > 0 ? std::atoll(env) : 1 << 16;
+        buffer->events = new AUTOPAR_TraceEvent[buffer->capacity];
+        buffer->thread = thread;
+
+        std::lock_guard<std::mutex> guard(global.lock);
+        global.threads.push_back(buffer);
+    }
+
+    buffer->events[buffer->count++ % buffer->capacity] = {start, end, site};
+}
@@ -0,0 +1,597 @@
+#ifndef AUTOPAR_RT_HPP
+#define AUTOPAR_RT_HPP
+
+/*
+runtime of the code generated by autopar. The fast paths are inline, the state shared by every
+transformed translation unit is defined once in autopar_rt.cpp. The symbols declared below form
+the ABI of the library, which only changes along with AUTOPAR_RT_ABI_VERSION
+*/
+
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define AUTOPAR_RT_ABI_VERSION 3
+
+enum AUTOPAR_TASK_LIMITER {
+    AUTOPAR_TASK_LIMITER_NO = 0,
+    AUTOPAR_TASK_NO_LIMIT = 1 << 0,
+    AUTOPAR_TASK_LIMITER_DEPTH = 1 << 1,
+    AUTOPAR_TASK_LIMITER_NB = 1 << 2,
+    AUTOPAR_TASK_LIMITER_BOTH = ~AUTOPAR_TASK_NO_LIMIT
+};
+
+/* read once from AUTOPAR_LIMITER, AUTOPAR_MAX_NB_TASKS and AUTOPAR_MAX_DEPTH */
+extern const int AUTOPAR_currentLimiter;
+extern const int AUTOPAR_maxtask;
+extern const int AUTOPAR_maxdepth;
+
+/* tasks currently created under the NB limiter, and depth of the task running on each thread */
+extern std::atomic<int> AUTOPAR_nbtask;
+extern thread_local int AUTOPAR_nbdepth;
+
+inline bool AUTOPAR_AdmitNb(int maxtask) {
+    return AUTOPAR_currentLimiter != AUTOPAR_TASK_LIMITER_NO
+        && (AUTOPAR_currentLimiter == AUTOPAR_TASK_NO_LIMIT
+            || ((AUTOPAR_currentLimiter & AUTOPAR_TASK_LIMITER_NB)
+                && AUTOPAR_nbtask.load(std::memory_order_relaxed) < maxtask));
+}
+
+inline bool AUTOPAR_AdmitDepth(int depth, int maxdepth) {
+    return AUTOPAR_currentLimiter != AUTOPAR_TASK_LIMITER_NO
+        && (AUTOPAR_currentLimiter == AUTOPAR_TASK_NO_LIMIT
+            || ((AUTOPAR_currentLimiter & AUTOPAR_TASK_LIMITER_DEPTH)
+                && depth < maxdepth));
+}
+
+inline void AUTOPAR_TaskSpawned() {
+    AUTOPAR_nbtask.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void AUTOPAR_TaskDone() {
+    AUTOPAR_nbtask.fetch_sub(1, std::memory_order_relaxed);
+}
+
+/*
+adaptive limits (autopar --adaptive): every taskgroup function owns a tuner that times its outermost
+invocations and hill-climbs over the depth and NB limits, measuring each configuration on a few invocations
+*/
+struct AUTOPAR_TunerConfig {
+    int depth;
+    int nbtasks;
+};
+
+inline int AUTOPAR_TuneEnv(const char *name, int value) {
+    const char *env_p = std::getenv(name);
+    return env_p && std::atoi(env_p) > 0 ? std::atoi(env_p) : value;
+}
+
+struct AUTOPAR_Tuner {
+    std::atomic<bool> running{false};
+    std::atomic<int> depthLimit{AUTOPAR_maxdepth};
+    std::atomic<int> taskLimit{AUTOPAR_maxtask};
+
+    /* search state, only used by the outermost invocation */
+    AUTOPAR_TunerConfig current = {AUTOPAR_maxdepth, AUTOPAR_maxtask};
+    double currentTime = -1.0;
+    std::vector<AUTOPAR_TunerConfig> neighbors;
+    size_t next = 0;
+    AUTOPAR_TunerConfig bestNeighbor = current;
+    double bestNeighborTime = std::numeric_limits<double>::max();
+    int samples = 0;
+    double sampleMin = std::numeric_limits<double>::max();
+    bool converged = false;
+
+    int depth() const { return depthLimit.load(std::memory_order_relaxed); }
+    int nbtasks() const { return taskLimit.load(std::memory_order_relaxed); }
+
+    void apply(const AUTOPAR_TunerConfig &config) {
+        depthLimit.store(config.depth, std::memory_order_relaxed);
+        taskLimit.store(config.nbtasks, std::memory_order_relaxed);
+    }
+
+    void explore() {
+        neighbors.clear();
+        if (current.depth > 0) neighbors.push_back({current.depth - 1, current.nbtasks});
+        if (current.depth < 64) neighbors.push_back({current.depth + 1, current.nbtasks});
+        if (current.nbtasks > 1) neighbors.push_back({current.depth, current.nbtasks / 2});
+        if (current.nbtasks < (1 << 20)) neighbors.push_back({current.depth, current.nbtasks * 2});
+
+        next = 0;
+        bestNeighborTime = std::numeric_limits<double>::max();
+        apply(neighbors[0]);
+    }
+
+    /* the minimum of a few invocations is measured for each configuration to filter out noise */
+    void record(double seconds) {
+        if (converged) return;
+
+        sampleMin = seconds < sampleMin ? seconds : sampleMin;
+        if (++samples < AUTOPAR_TuneEnv("AUTOPAR_TUNE_SAMPLES", 3)) return;
+
+        double measured = sampleMin;
+        samples = 0;
+        sampleMin = std::numeric_limits<double>::max();
+
+        if (currentTime < 0) {
+            currentTime = measured;
+            explore();
+            return;
+        }
+
+        if (measured < bestNeighborTime) {
+            bestNeighborTime = measured;
+            bestNeighbor = neighbors[next];
+        }
+
+        if (++next < neighbors.size()) {
+            apply(neighbors[next]);
+            return;
+        }
+
+        /* moves only for a gain above the noise, 2% by default */
+        if (bestNeighborTime < currentTime * (1.0 - AUTOPAR_TuneEnv("AUTOPAR_TUNE_GAIN", 2) / 100.0)) {
+            current = bestNeighbor;
+            currentTime = bestNeighborTime;
+            explore();
+            return;
+        }
+
+        converged = true;
+        apply(current);
+        if (std::getenv("AUTOPAR_TUNE_LOG")) {
+            std::fprintf(stderr, "autopar: tuned depth %d, nb tasks %d (%.6f s)\n", current.depth, current.nbtasks, currentTime);
+        }
+    }
+};
+
+/* times an invocation if no other invocation of the same function is running */
+struct AUTOPAR_TuneScope {
+    AUTOPAR_Tuner &tuner;
+    bool outermost;
+    std::chrono::steady_clock::time_point start;
+
+    AUTOPAR_TuneScope(AUTOPAR_Tuner &tuner)
+        : tuner(tuner), outermost(!tuner.running.exchange(true)), start(std::chrono::steady_clock::now()) {}
+
+    ~AUTOPAR_TuneScope() {
+        if (!outermost) return;
+        tuner.record(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        tuner.running.store(false);
+    }
+};
+
+/*
+runs `body` in the current team, or in a team started for it outside of a parallel region: the entry points
+of a library (autopar --library) and the parallel standard algorithms may be called from serial code
+*/
+template <typename F>
+void AUTOPAR_InTeam(F &&body) {
+    if (omp_in_parallel()) {
+        body();
+        return;
+    }
+#pragma omp parallel
+#pragma omp single
+    body();
+}
+
+/*
+cancellation (autopar --cancel): a function returning while its tasks only compute local variables cancels
+its taskgroup, so that the tasks which haven't started are discarded. OpenMP only cancels with
+OMP_CANCELLATION=true, otherwise the function still waits for them. Discarded tasks never run their
+epilogue, so the group gives their NB count back once the taskgroup has ended
+*/
+class AUTOPAR_CancelGroup {
+public:
+    ~AUTOPAR_CancelGroup() {
+        int discarded = nbSpawned.load(std::memory_order_relaxed) - nbStarted.load(std::memory_order_relaxed);
+        if (discarded) AUTOPAR_nbtask.fetch_sub(discarded, std::memory_order_relaxed);
+    }
+
+    void spawned() { nbSpawned.fetch_add(1, std::memory_order_relaxed); }
+    void started() { nbStarted.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    std::atomic<int> nbSpawned{0};
+    std::atomic<int> nbStarted{0};
+};
+
+/* `cancel taskgroup` has to be nested in a task, while the function runs in the task that created the group */
+inline void AUTOPAR_CancelTaskgroup() {
+    if (!omp_get_cancellation()) {
+        static std::atomic<bool> warned{false};
+        if (!warned.exchange(true)) {
+            std::fprintf(stderr, "autopar: OMP_CANCELLATION is not true, early returns wait for their pending tasks\n");
+        }
+        return;
+    }
+
+#pragma omp task if(0)
+    {
+#pragma omp cancel taskgroup
+    }
+}
+
+/*
+result of a call turned into a task: the task constructs the value in place in uninitialized storage,
+so the type needs neither a default constructor nor an assignment. The variable of the declaration
+becomes a reference to the storage. The temporaries of decomposed expressions are constructed again
+on every execution of their statement, after the task reading the previous value
+*/
+template <typename T>
+class AUTOPAR_Slot {
+public:
+    AUTOPAR_Slot() = default;
+    AUTOPAR_Slot(const AUTOPAR_Slot &) = delete;
+    AUTOPAR_Slot &operator=(const AUTOPAR_Slot &) = delete;
+
+    ~AUTOPAR_Slot() {
+        destroy();
+    }
+
+    /* the prvalue returned by `make` initializes the storage directly */
+    template <typename F>
+    void construct(F &&make) {
+        destroy();
+        ::new (static_cast<void *>(storage)) T(make());
+        constructed = true;
+    }
+
+    void destroy() {
+        if (constructed) {
+            get().~T();
+            constructed = false;
+        }
+    }
+
+    T &get() { return *reinterpret_cast<T *>(storage); }
+
+    /* a temporary is used once */
+    T &&take() { return static_cast<T &&>(get()); }
+
+private:
+    alignas(T) unsigned char storage[sizeof(T)];
+    bool constructed = false;
+};
+
+/*
+scope of a result whose type has a destructor. The slot outlives the block declaring the result, so
+the value is destroyed here instead, where the declaration would have destroyed it, once the tasks
+writing or reading it are done
+*/
+template <typename T>
+class AUTOPAR_SlotScope {
+public:
+    explicit AUTOPAR_SlotScope(AUTOPAR_Slot<T> &slot) : slot(slot) {}
+    AUTOPAR_SlotScope(const AUTOPAR_SlotScope &) = delete;
+    AUTOPAR_SlotScope &operator=(const AUTOPAR_SlotScope &) = delete;
+
+    ~AUTOPAR_SlotScope() {
+        if constexpr (!std::is_trivially_destructible<T>::value) release();
+    }
+
+private:
+    AUTOPAR_Slot<T> &slot;
+
+    /* not in the destructor itself, whose clones make GCC 12 crash on the depend clause */
+    void release() {
+        T &value = slot.get();
+#pragma omp taskwait depend(inout: value)
+        slot.destroy();
+    }
+};
+
+/*
+memo table of a pure function (autopar --memoize), keyed by its arithmetic arguments. The table holds
+a fixed number of entries indexed by a hash of the key, a colliding call replaces the entry, and an
+entry used by another thread counts as a miss rather than being waited for. Keys are compared bitwise,
+so that 0.0 and -0.0 are different arguments and NaN arguments can still hit
+*/
+#define AUTOPAR_MEMO_ENTRIES 4096
+
+template <typename R, typename... Args>
+class AUTOPAR_Memo {
+public:
+    using Key = std::tuple<Args...>;
+
+    static Key key(const Args &...args) { return Key(args...); }
+
+    bool find(const Key &key, R &result) {
+        Entry &entry = entries[index(key)];
+        if (entry.busy.exchange(true, std::memory_order_acquire)) return false;
+
+        bool hit = entry.valid && same(entry.key, key);
+        if (hit) result = entry.value;
+
+        entry.busy.store(false, std::memory_order_release);
+        return hit;
+    }
+
+    const R &store(const Key &key, const R &result) {
+        Entry &entry = entries[index(key)];
+        if (entry.busy.exchange(true, std::memory_order_acquire)) return result;
+
+        entry.key = key;
+        entry.value = result;
+        entry.valid = true;
+
+        entry.busy.store(false, std::memory_order_release);
+        return result;
+    }
+
+private:
+    struct Entry {
+        std::atomic<bool> busy{false};
+        bool valid = false;
+        Key key;
+        R value;
+    };
+
+    Entry entries[AUTOPAR_MEMO_ENTRIES];
+
+    template <typename T>
+    static void hashBytes(std::size_t &hash, const T &value) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+
+    static std::size_t index(const Key &key) {
+        std::size_t hash = 14695981039346656037ULL;
+        std::apply([&](const Args &...args) { (hashBytes(hash, args), ...); }, key);
+        return hash % AUTOPAR_MEMO_ENTRIES;
+    }
+
+    template <std::size_t... I>
+    static bool same(const Key &a, const Key &b, std::index_sequence<I...>) {
+        return (... && (std::memcmp(&std::get<I>(a), &std::get<I>(b), sizeof(std::get<I>(a))) == 0));
+    }
+
+    static bool same(const Key &a, const Key &b) {
+        return same(a, b, std::index_sequence_for<Args...>());
+    }
+};
+
+/*
+task-parallel versions of standard algorithms (autopar --parallel-std). MinSize is the number of elements
+below which a range is processed serially, and the smallest part of a range a task handles. A range is split
+in about four parts per thread, processed by the tasks of the current team, or of a team started for the
+call outside of a parallel region
+*/
+inline std::ptrdiff_t AUTOPAR_StdGrain(std::ptrdiff_t n, std::ptrdiff_t minSize) {
+    int threads = omp_in_parallel() ? omp_get_num_threads() : omp_get_max_threads();
+    std::ptrdiff_t grain = n / (4 * threads);
+    return grain > minSize ? grain : minSize;
+}
+
+/* merges by splitting the larger range at its middle element and the other one at the same value */
+template <typename In, typename Out, typename Compare>
+void AUTOPAR_ParallelMerge(In first1, In last1, In first2, In last2, Out out, Compare comp, std::ptrdiff_t grain) {
+    std::ptrdiff_t n1 = last1 - first1;
+    std::ptrdiff_t n2 = last2 - first2;
+
+    if (n1 + n2 <= grain) {
+        std::merge(std::make_move_iterator(first1), std::make_move_iterator(last1),
+                   std::make_move_iterator(first2), std::make_move_iterator(last2), out, comp);
+        return;
+    }
+
+    if (n1 < n2) {
+        std::swap(first1, first2);
+        std::swap(last1, last2);
+    }
+
+    In mid1 = first1 + (last1 - first1) / 2;
+    In mid2 = std::lower_bound(first2, last2, *mid1, comp);
+    Out outMid = out + (mid1 - first1) + (mid2 - first2);
+    *outMid = std::move(*mid1);
+
+#pragma omp task
+    AUTOPAR_ParallelMerge(first1, mid1, first2, mid2, out, comp, grain);
+#pragma omp task
+    AUTOPAR_ParallelMerge(mid1 + 1, last1, mid2, last2, outMid + 1, comp, grain);
+#pragma omp taskwait
+}
+
+/* sorts the n elements of `src`, into `dst` if `toDst`. The halves are sorted into the other array and merged back */
+template <typename Src, typename Dst, typename Compare>
+void AUTOPAR_SortInto(Src src, Dst dst, std::ptrdiff_t n, Compare comp, std::ptrdiff_t grain, bool toDst) {
+    if (n <= grain) {
+        std::sort(src, src + n, comp);
+        if (toDst) std::move(src, src + n, dst);
+        return;
+    }
+
+    std::ptrdiff_t half = n / 2;
+
+#pragma omp task
+    AUTOPAR_SortInto(src, dst, half, comp, grain, !toDst);
+#pragma omp task
+    AUTOPAR_SortInto(src + half, dst + half, n - half, comp, grain, !toDst);
+#pragma omp taskwait
+
+    if (toDst) {
+        AUTOPAR_ParallelMerge(src, src + half, src + half, src + n, dst, comp, grain);
+    } else {
+        AUTOPAR_ParallelMerge(dst, dst + half, dst + half, dst + n, src, comp, grain);
+    }
+}
+
+template <std::ptrdiff_t MinSize, typename It, typename Compare = std::less<>>
+void AUTOPAR_ParallelSort(It first, It last, Compare comp = Compare()) {
+    std::ptrdiff_t n = last - first;
+    std::ptrdiff_t grain = AUTOPAR_StdGrain(n, MinSize);
+    if (n <= grain) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    /* the elements are moved out and sorted back into the range */
+    std::vector<typename std::iterator_traits<It>::value_type> buffer(std::make_move_iterator(first), std::make_move_iterator(last));
+    AUTOPAR_InTeam([&] { AUTOPAR_SortInto(buffer.begin(), first, n, comp, grain, true); });
+}
+
+template <std::ptrdiff_t MinSize, typename In, typename Out, typename Op>
+Out AUTOPAR_ParallelTransform(In first, In last, Out out, Op op) {
+    std::ptrdiff_t n = last - first;
+    std::ptrdiff_t grain = AUTOPAR_StdGrain(n, MinSize);
+    if (n <= grain) return std::transform(first, last, out, op);
+
+    AUTOPAR_InTeam([&] {
+#pragma omp taskloop grainsize(grain)
+        for (std::ptrdiff_t i = 0; i < n; ++i) {
+            out[i] = op(first[i]);
+        }
+    });
+    return out + n;
+}
+
+template <std::ptrdiff_t MinSize, typename In1, typename In2, typename Out, typename Op>
+Out AUTOPAR_ParallelTransform(In1 first1, In1 last1, In2 first2, Out out, Op op) {
+    std::ptrdiff_t n = last1 - first1;
+    std::ptrdiff_t grain = AUTOPAR_StdGrain(n, MinSize);
+    if (n <= grain) return std::transform(first1, last1, first2, out, op);
+
+    AUTOPAR_InTeam([&] {
+#pragma omp taskloop grainsize(grain)
+        for (std::ptrdiff_t i = 0; i < n; ++i) {
+            out[i] = op(first1[i], first2[i]);
+        }
+    });
+    return out + n;
+}
+
+template <std::ptrdiff_t MinSize, typename It, typename F>
+F AUTOPAR_ParallelForEach(It first, It last, F f) {
+    std::ptrdiff_t n = last - first;
+    std::ptrdiff_t grain = AUTOPAR_StdGrain(n, MinSize);
+    if (n <= grain) return std::for_each(first, last, f);
+
+    AUTOPAR_InTeam([&] {
+#pragma omp taskloop grainsize(grain)
+        for (std::ptrdiff_t i = 0; i < n; ++i) {
+            f(first[i]);
+        }
+    });
+    return f;
+}
+
+/* the halves are reduced by two tasks and combined in order, so `op` only needs to be associative, which excludes floating point */
+template <typename T, typename It, typename Op>
+T AUTOPAR_ReduceInto(It first, std::ptrdiff_t n, Op op, std::ptrdiff_t grain) {
+    if (n <= grain) return std::accumulate(first + 1, first + n, T(*first), op);
+
+    std::ptrdiff_t half = n / 2;
+    T left, right;
+
+#pragma omp task shared(left)
+    left = AUTOPAR_ReduceInto<T>(first, half, op, grain);
+#pragma omp task shared(right)
+    right = AUTOPAR_ReduceInto<T>(first + half, n - half, op, grain);
+#pragma omp taskwait
+
+    return op(left, right);
+}
+
+template <std::ptrdiff_t MinSize, typename It, typename T, typename Op = std::plus<>>
+T AUTOPAR_ParallelAccumulate(It first, It last, T init, Op op = Op()) {
+    std::ptrdiff_t n = last - first;
+    std::ptrdiff_t grain = AUTOPAR_StdGrain(n, MinSize);
+    if (n <= grain) return std::accumulate(first, last, init, op);
+
+    T sum;
+    AUTOPAR_InTeam([&] { sum = AUTOPAR_ReduceInto<T>(first, n, op, grain); });
+    return op(init, sum);
+}
+
+/*
+first touch (autopar --numa): pages are placed on the NUMA node of the thread writing them first, so the
+pages of large allocations are touched by all the threads before their serial initialization
+*/
+#define AUTOPAR_FIRST_TOUCH_MIN_BYTES (1 << 20)
+
+void AUTOPAR_FirstTouch(void *data, std::size_t bytes);
+
+template <typename T>
+struct AUTOPAR_FirstTouchAllocator {
+    using value_type = T;
+
+    AUTOPAR_FirstTouchAllocator() = default;
+
+    template <typename U>
+    AUTOPAR_FirstTouchAllocator(const AUTOPAR_FirstTouchAllocator<U> &) {}
+
+    T *allocate(std::size_t n) {
+        T *data = std::allocator<T>().allocate(n);
+        AUTOPAR_FirstTouch(data, n * sizeof(T));
+        return data;
+    }
+
+    void deallocate(T *data, std::size_t n) {
+        std::allocator<T>().deallocate(data, n);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const AUTOPAR_FirstTouchAllocator<T> &, const AUTOPAR_FirstTouchAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const AUTOPAR_FirstTouchAllocator<T> &, const AUTOPAR_FirstTouchAllocator<U> &) {
+    return false;
+}
+
+/*
+instrumentation (autopar --instrument and --trace): every output file numbers its own sites and registers
+their table on its first probe, the counters and trace buffers are shared by the process, so that a program
+made of several output files writes a single report, profile and trace at exit
+*/
+struct AUTOPAR_Site {
+    const char *kind;
+    const char *callee;
+    const char *file;
+    int line;
+    int column;
+};
+
+inline unsigned long long AUTOPAR_Ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/* returns the process-wide index of the first site of the table */
+int AUTOPAR_RegisterSites(const AUTOPAR_Site *sites, int count);
+
+/* per-thread counters, reported with AUTOPAR_STATS and written to AUTOPAR_PROFILE */
+void AUTOPAR_CountSpawn(int site, bool created);
+void AUTOPAR_CountProbe(int site, unsigned long long start, unsigned long long end, bool wait, int depth);
+
+/* per-thread ring buffers, written to AUTOPAR_TRACE */
+void AUTOPAR_TraceProbe(int site, unsigned long long start, unsigned long long end, int thread);
+
+#endif
@@ -0,0 +1,409 @@
+#ifndef AUTOPAR_WS_HPP
+#define AUTOPAR_WS_HPP
+
+/*
+work-stealing backend of autopar (autopar --backend=ws), header-only.
+
+Every worker owns a Chase-Lev deque: it pushes and pops its own tasks at the bottom while idle
+workers steal from the top. Tasks are spawned into the TaskGroup of the function invocation that
+creates them, which orders siblings like OpenMP depend clauses by keeping, per address, the last
+writer and the readers since. A TaskGroup waits for its tasks when destroyed, and waiting threads
+execute other tasks in the meantime. Threads are started at the first spawn, OMP_NUM_THREADS of
+them (including the spawning thread) or one per hardware thread.
+*/
+
+#include "autopar_rt.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace autopar_ws {
+
+class TaskGroup;
+
+struct Task {
+    std::function<void()> fn;
+    TaskGroup *group;
+    std::atomic<int> pending{1}; /* unfinished predecessors, plus one until the task is fully registered */
+    std::mutex lock;
+    std::vector<Task *> successors;
+    bool done = false;
+};
+
+/* dynamic circular array of a deque, retired arrays are kept until the deque is destroyed */
+struct TaskArray {
+    long capacity;
+    std::unique_ptr<std::atomic<Task *>[]> slots;
+
+    explicit TaskArray(long capacity) : capacity(capacity), slots(new std::atomic<Task *>[capacity]) {}
+
+    Task *get(long i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+    void put(long i, Task *task) { slots[i & (capacity - 1)].store(task, std::memory_order_relaxed); }
+};
+
+/* Chase-Lev deque, with the memory orders of Le et al. "Correct and efficient work-stealing for weak memory models" */
+class Deque {
+public:
+    Deque() : array(new TaskArray(1024)) {}
+
+    ~Deque() {
+        delete array.load(std::memory_order_relaxed);
+        for (TaskArray *old : retired) delete old;
+    }
+
+    /* owner only */
+    void push(Task *task) {
+        long b = bottom.load(std::memory_order_relaxed);
+        long t = top.load(std::memory_order_acquire);
+        TaskArray *a = array.load(std::memory_order_relaxed);
+
+        if (b - t > a->capacity - 1) {
+            TaskArray *bigger = new TaskArray(a->capacity * 2);
+            for (long i = t; i < b; ++i) bigger->put(i, a->get(i));
+            retired.push_back(a);
+            array.store(bigger, std::memory_order_release);
+            a = bigger;
+        }
+
+        a->put(b, task);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /* owner only */
+    Task *pop() {
+        long b = bottom.load(std::memory_order_relaxed) - 1;
+        TaskArray *a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Task *task = a->get(b);
+        if (t == b) {
+            /* last task, race against thieves */
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return task;
+    }
+
+    Task *steal() {
+        long t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) return nullptr;
+
+        TaskArray *a = array.load(std::memory_order_acquire);
+        Task *task = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+
+        return task;
+    }
+
+private:
+    std::atomic<long> top{0};
+    std::atomic<long> bottom{0};
+    std::atomic<TaskArray *> array;
+    std::vector<TaskArray *> retired;
+};
+
+inline thread_local int workerId = -1;
+inline thread_local TaskGroup *currentGroup = nullptr;
+
+class Scheduler {
+public:
+    static Scheduler &get() {
+        static Scheduler scheduler;
+        return scheduler;
+    }
+
+    void schedule(Task *task) {
+        if (workerId >= 0) {
+            deques[workerId]->push(task);
+        } else {
+            std::lock_guard<std::mutex> guard(injectionLock);
+            injection.push_back(task);
+        }
+
+        epoch.fetch_add(1, std::memory_order_release);
+        if (sleepers.load(std::memory_order_acquire) > 0) {
+            wakeup.notify_one();
+        }
+    }
+
+    Task *findWork() {
+        if (workerId >= 0) {
+            if (Task *task = deques[workerId]->pop()) return task;
+        }
+
+        static thread_local std::minstd_rand random(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        size_t nbDeques = deques.size();
+        size_t first = random() % nbDeques;
+        for (size_t i = 0; i < nbDeques; ++i) {
+            size_t victim = (first + i) % nbDeques;
+            if ((int) victim == workerId) continue;
+            if (Task *task = deques[victim]->steal()) return task;
+        }
+
+        std::lock_guard<std::mutex> guard(injectionLock);
+        if (injection.empty()) return nullptr;
+        Task *task = injection.back();
+        injection.pop_back();
+        return task;
+    }
+
+    void execute(Task *task);
+
+    ~Scheduler() {
+        stopping.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            wakeup.notify_all();
+        }
+        for (std::thread &thread : threads) thread.join();
+    }
+
+private:
+    std::vector<std::unique_ptr<Deque>> deques;
+    std::vector<std::thread> threads;
+    std::mutex injectionLock;
+    std::vector<Task *> injection;
+    std::atomic<bool> stopping{false};
+    std::atomic<unsigned> epoch{0};
+    std::atomic<int> sleepers{0};
+    std::mutex sleepLock;
+    std::condition_variable wakeup;
+
+    /* the thread creating the scheduler becomes worker 0 */
+    Scheduler() {
+        int nbThreads = 0;
+        if (const char *env_p = std::getenv("OMP_NUM_THREADS")) nbThreads = std::atoi(env_p);
+        if (nbThreads <= 0) nbThreads = std::thread::hardware_concurrency();
+        if (nbThreads <= 0) nbThreads = 1;
+
+        for (int i = 0; i < nbThreads; ++i) deques.emplace_back(new Deque());
+
+        workerId = 0;
+        for (int i = 1; i < nbThreads; ++i) {
+            threads.emplace_back([this, i]() { work(i); });
+        }
+    }
+
+    void work(int id) {
+        workerId = id;
+
+        while (!stopping.load(std::memory_order_acquire)) {
+            unsigned seen = epoch.load(std::memory_order_acquire);
+
+            if (Task *task = findWork()) {
+                execute(task);
+                continue;
+            }
+
+            /* sleep until a task is scheduled, with a timeout in case the wakeup was missed */
+            std::unique_lock<std::mutex> guard(sleepLock);
+            sleepers.fetch_add(1, std::memory_order_acq_rel);
+            if (epoch.load(std::memory_order_acquire) == seen && !stopping.load(std::memory_order_acquire)) {
+                wakeup.wait_for(guard, std::chrono::milliseconds(1));
+            }
+            sleepers.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+};
+
+struct Dep {
+    const void *addr;
+    bool write;
+};
+
+inline Dep in(const void *addr) { return {addr, false}; }
+inline Dep inout(const void *addr) { return {addr, true}; }
+
+/* tasks created by one invocation of a parallelized function, the equivalent of an OpenMP taskgroup */
+class TaskGroup {
+public:
+    TaskGroup() : parent(currentGroup) {
+        Scheduler::get();
+        currentGroup = this;
+    }
+
+    ~TaskGroup() {
+        wait();
+        currentGroup = parent;
+    }
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    /* the equivalent of `#pragma omp task depend(...) if(defer)` */
+    template <typename F>
+    void spawn(bool defer, std::initializer_list<Dep> deps, F &&fn) {
+        /* with no sibling pending, an undeferred task has nothing to wait for nor to be waited by */
+        if (!defer && (deps.size() == 0 || active.load(std::memory_order_acquire) == 0)) {
+            runUndeferred(std::forward<F>(fn));
+            return;
+        }
+
+        tasks.emplace_back(new Task());
+        Task *task = tasks.back().get();
+        task->fn = std::forward<F>(fn);
+        task->group = this;
+        active.fetch_add(1, std::memory_order_relaxed);
+
+        for (const Dep &dep : deps) {
+            Access &access = accesses[dep.addr];
+
+            if (!dep.write) {
+                if (access.writer) depend(access.writer, task);
+                access.readers.push_back(task);
+            } else {
+                if (access.readers.empty()) {
+                    if (access.writer) depend(access.writer, task);
+                } else {
+                    for (Task *reader : access.readers) depend(reader, task);
+                    access.readers.clear();
+                }
+                access.writer = task;
+            }
+        }
+
+        if (defer) {
+            if (task->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                Scheduler::get().schedule(task);
+            }
+            return;
+        }
+
+        /* undeferred: run on this thread once the predecessors are done */
+        helpUntil([task]() { return task->pending.load(std::memory_order_acquire) == 1; });
+        task->pending.store(0, std::memory_order_relaxed);
+        Scheduler::get().execute(task);
+    }
+
+    /* the equivalent of `#pragma omp taskwait` for the tasks of this group */
+    void wait() {
+        helpUntil([this]() { return active.load(std::memory_order_acquire) == 0; });
+        accesses.clear();
+        tasks.clear();
+    }
+
+    void complete() {
+        active.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+private:
+    struct Access {
+        Task *writer = nullptr;
+        std::vector<Task *> readers;
+    };
+
+    TaskGroup *parent;
+    std::atomic<int> active{0};
+    std::unordered_map<const void *, Access> accesses;
+    std::vector<std::unique_ptr<Task>> tasks;
+
+    static void depend(Task *predecessor, Task *successor) {
+        std::lock_guard<std::mutex> guard(predecessor->lock);
+        if (!predecessor->done) {
+            successor->pending.fetch_add(1, std::memory_order_relaxed);
+            predecessor->successors.push_back(successor);
+        }
+    }
+
+    template <typename F>
+    static void runUndeferred(F &&fn) {
+        TaskGroup *saved = currentGroup;
+        currentGroup = nullptr;
+        fn();
+        currentGroup = saved;
+    }
+
+    template <typename Predicate>
+    static void helpUntil(Predicate done) {
+        Scheduler &scheduler = Scheduler::get();
+        int idle = 0;
+
+        while (!done()) {
+            if (Task *task = scheduler.findWork()) {
+                scheduler.execute(task);
+                idle = 0;
+            } else if (++idle < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    }
+};
+
+inline void Scheduler::execute(Task *task) {
+    TaskGroup *saved = currentGroup;
+    currentGroup = nullptr;
+    task->fn();
+    currentGroup = saved;
+
+    std::vector<Task *> successors;
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->done = true;
+        successors.swap(task->successors);
+    }
+
+    for (Task *successor : successors) {
+        if (successor->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            schedule(successor);
+        }
+    }
+
+    task->group->complete();
+}
+
+/* waits for the tasks created by the current function invocation */
+inline void taskwait() {
+    if (currentGroup) currentGroup->wait();
+}
+
+/* AUTOPAR_SlotScope, waiting in the group of the function declaring the result */
+template <typename T>
+class SlotScope {
+public:
+    SlotScope(TaskGroup &group, AUTOPAR_Slot<T> &slot) : group(group), slot(slot) {}
+    SlotScope(const SlotScope &) = delete;
+    SlotScope &operator=(const SlotScope &) = delete;
+
+    ~SlotScope() {
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            group.spawn(false, {inout(&slot.get())}, [] {});
+            slot.destroy();
+        }
+    }
+
+private:
+    TaskGroup &group;
+    AUTOPAR_Slot<T> &slot;
+};
+
+}
+
+#endif
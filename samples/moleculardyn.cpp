@@ -120,6 +120,14 @@ public:
 
         return particlesToRemove;
     }
+
+    double sumPositions() const {
+        double sum = 0;
+        for(int idxPart = 0 ; idxPart < int(particles.size()) ; ++idxPart){
+            sum += particles[idxPart].x + particles[idxPart].y + particles[idxPart].z;
+        }
+        return sum;
+    }
 };
 
 
@@ -251,6 +259,14 @@ public:
             cells[cellIdx].addParticle(particles[idxPart]);
         }
     }
+
+    double sumPositions() const {
+        double sum = 0;
+        for(int idxCell = 0 ; idxCell < int(cells.size()) ; ++idxCell){
+            sum += cells[idxCell].sumPositions();
+        }
+        return sum;
+    }
 };
 
 
@@ -286,5 +302,7 @@ int main(){
         grid.update(TimeStep);
     }
 
+    std::cout << "Sum of the positions: " << grid.sumPositions() << std::endl;
+
     return 0;
 }
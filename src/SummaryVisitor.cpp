@@ -0,0 +1,16 @@
+#include <visitors.hpp>
+#include <summaries.hpp>
+
+
+/* PUBLICS */
+
+
+bool SummaryVisitor::VisitFunctionDecl(FunctionDecl *f) {
+    if (!AC.getSourceManager().isInMainFile(f->getLocation())) return true;
+    if (!f->doesThisDeclarationHaveABody() || f->isDependentContext()) return true;
+    if (!f->getIdentifier() || f->isInStdNamespace()) return true;
+
+    SummaryIndex::get().add(computeFunctionSummary(f, AC));
+
+    return true;
+}
@@ -6,6 +6,19 @@
 
 bool TaskCreationVisitor::VisitDeclStmt(DeclStmt *DeclStat) {
     if (!isFromMainFile(DeclStat->getBeginLoc())) return true;
+    llvm::TimeTraceScope TimeScope("VisitDeclStmt");
+
+    if (Numa) {
+        placeFirstTouch(DeclStat);
+    }
+
+    if (isDecomposed(DeclStat)) return true;
+
+    if (DeclStat->isSingleDecl()) {
+        auto *var = llvm::dyn_cast<VarDecl>(DeclStat->getSingleDecl());
+        if (var && var->hasInit() && decomposeCalls(DeclStat, var->getInit(), var)) return true;
+    }
+
     int nbCallExprs = countCallExprs(DeclStat);
 
     if (nbCallExprs > 0) {
@@ -18,72 +31,64 @@ bool TaskCreationVisitor::VisitDeclStmt(DeclStmt *DeclStat) {
         if (const auto *VarDecl = llvm::dyn_cast<clang::VarDecl>(Decl)) {
             if (VarDecl->hasInit() && llvm::isa<CallExpr>(VarDecl->getInit())) {
                 const auto *FCall = llvm::cast<clang::CallExpr>(VarDecl->getInit());
-                const FunctionDecl *CalledFunc = FCall->getDirectCallee();
 
-                if (CalledFunc && CalledFunc->isDefined() && !CalledFunc->isStdNamespace() && CalledFunc->getIdentifier()) {
+                if (const FunctionDecl *CalledFunc = getTaskCallee(FCall)) {
+                    PureCall pureCall;
+                    bool pure = getPureCall(CalledFunc, FCall, VarDecl, DeclStat, AC, pureCall);
+
+                    if (pure) {
+                        const PureCall *earlier = findReusableCall(pureCalls, pureCall, currentFunction, AC);
+                        if (earlier && reusePureCall(*earlier, VarDecl, DeclStat, FCall)) continue;
+                    }
+
                     DependInfo depInfo = getFCallDependencies(CalledFunc, FCall, RW); /* MUST BE BEFORE REWRITING */
 
                     std::string varName = VarDecl->getNameAsString();
-                    std::string varType = VarDecl->getType().getAsString();
-                    varType = varType.find("const") != std::string::npos ? varType.substr(6) : varType;
-
-                    std::string initializer = varName + " = " + RW.getRewrittenText(VarDecl->getInit()->getSourceRange()) + ";";
-                    RW.ReplaceText(VarDecl->getSourceRange(), varType.append(" ").append(varName));
+                    std::string initializer = declareResultSlot(VarDecl);
+                    if (initializer.empty()) continue;
 
+                    if (pure) {
+                        pureCalls.push_back(pureCall);
+                    }
 
                     depInfo.write.insert(varName);
-                    std::string depClause = constructDependClause(depInfo);
 
                     if (shouldAddTaskWait(depInfo)) {
-                        RW.InsertText(DeclStat->getEndLoc().getLocWithOffset(1), "\n#pragma omp taskwait\n", true, true);
+                        RW.InsertText(DeclStat->getEndLoc().getLocWithOffset(1), "\n" + taskWait(DeclStat->getBeginLoc()) + "\n", true, true);
                     }
 
+                    TaskPlan plan = planTask(depInfo, FCall);
                     RW.InsertText(DeclStat->getEndLoc().getLocWithOffset(1), 
-                        AUTOPAR_PRE_TASK + 
-                        std::string("\n#pragma omp task ").append(depClause).append(" ").append(AUTOPAR_TASK_CLAUSE)
-                            .append("\n{\n")
-                            .append("if (AUTOPAR_createtaskdepth || AUTOPAR_createtasknbr) {\n\tAUTOPAR_nbdepth=AUTOPAR_lnbdepth+1;\n}\n\n")
-                            .append(initializer)
-                            .append("\n\nif (AUTOPAR_createtasknbr) {\n\t#pragma omp atomic\n\tAUTOPAR_nbtask--;\n}\n")
-                            .append("}\n"),
+                        taskBegin(plan) + initializer + taskEnd(plan, initializer),
                         true, true);
 
-                    addTask(depInfo);
+                    addTask(depInfo, CalledFunc, FCall);
+                    addSpawn(DeclStat);
                 }
 
             } else if (VarDecl->hasInit() && nbCallExprs == 1) {
                 if (auto *Expr = VarDecl->getInit()->getExprStmt()) {
                     if (const CallExpr *FCall = findCallExpr(Expr)) {
-                        const FunctionDecl *CalledFunc = FCall->getDirectCallee();
-
-                        if (CalledFunc && CalledFunc->isDefined() && !CalledFunc->isStdNamespace() && CalledFunc->getIdentifier()) {
+                        if (const FunctionDecl *CalledFunc = getTaskCallee(FCall)) {
                             DependInfo depInfo = getFCallDependencies(CalledFunc, FCall, RW); /* MUST BE BEFORE REWRITING */
 
                             std::string varName = VarDecl->getNameAsString();
-                            std::string varType = VarDecl->getType().getAsString();
-                            varType = varType.find("const") != std::string::npos ? varType.substr(6) : varType;
-
-                            std::string initializer = varName + " = " + RW.getRewrittenText(VarDecl->getInit()->getSourceRange()) + ";";
-                            RW.ReplaceText(VarDecl->getSourceRange(), varType.append(" ").append(varName));
+                            std::string initializer = declareResultSlot(VarDecl);
+                            if (initializer.empty()) continue;
 
                             depInfo.write.insert(varName);
-                            std::string depClause = constructDependClause(depInfo);
 
                             if (shouldAddTaskWait(depInfo)) {
-                                RW.InsertText(DeclStat->getEndLoc().getLocWithOffset(1), "\n#pragma omp taskwait\n", true, true);
+                                RW.InsertText(DeclStat->getEndLoc().getLocWithOffset(1), "\n" + taskWait(DeclStat->getBeginLoc()) + "\n", true, true);
                             }
 
+                            TaskPlan plan = planTask(depInfo, FCall);
                             RW.InsertText(DeclStat->getEndLoc().getLocWithOffset(1), 
-                                AUTOPAR_PRE_TASK + 
-                                std::string("\n#pragma omp task ").append(depClause).append(" ").append(AUTOPAR_TASK_CLAUSE)
-                                    .append("\n{\n")
-                                    .append("if (AUTOPAR_createtaskdepth || AUTOPAR_createtasknbr) {\n\tAUTOPAR_nbdepth=AUTOPAR_lnbdepth+1;\n}\n\n")
-                                    .append(initializer)
-                                    .append("\n\nif (AUTOPAR_createtasknbr) {\n\t#pragma omp atomic\n\tAUTOPAR_nbtask--;\n}\n")
-                                    .append("}\n"),
+                                taskBegin(plan) + initializer + taskEnd(plan, initializer),
                                 true, true);
 
-                            addTask(depInfo);
+                            addTask(depInfo, CalledFunc, FCall);
+                            addSpawn(DeclStat);
                         }
                     }
                 }
@@ -96,21 +101,35 @@ bool TaskCreationVisitor::VisitDeclStmt(DeclStmt *DeclStat) {
 
 bool TaskCreationVisitor::VisitCallExpr(CallExpr *FCall) {
     if (!isFromMainFile(FCall->getBeginLoc())) return true;
-    const FunctionDecl *CalledFunc = FCall->getDirectCallee();
-    if (CalledFunc && CalledFunc->isDefined() && !CalledFunc->isStdNamespace() && CalledFunc->getIdentifier() && ignoreCalls == 0) {
+    llvm::TimeTraceScope TimeScope("VisitCallExpr");
+
+    if (isDecomposed(FCall)) return true;
+
+    const FunctionDecl *CalledFunc = getTaskCallee(FCall);
+    if (CalledFunc) {
+        stats.callSites++;
+    }
+
+    if (CalledFunc && decomposeCalls(FCall, FCall, nullptr)) return true;
+
+    if (CalledFunc && ignoreCalls == 0) {
         DependInfo depInfo = getFCallDependencies(CalledFunc, FCall, RW);
-        std::string depClause = constructDependClause(depInfo);
+        std::string serialText = RW.getRewrittenText(FCall->getSourceRange()) + ";";
 
         if (shouldAddTaskWait(depInfo)) {
-            RW.InsertText(FCall->getBeginLoc(), "#pragma omp taskwait\n\n", true, true);
+            RW.InsertText(FCall->getBeginLoc(), taskWait(FCall->getBeginLoc()) + "\n\n", true, true);
         }
 
-        RW.InsertText(FCall->getBeginLoc(), AUTOPAR_PRE_TASK + "\n#pragma omp task " + depClause + " " + AUTOPAR_TASK_CLAUSE + "\n{\n", true, true);
-        RW.InsertText(FCall->getBeginLoc(), "if (AUTOPAR_createtaskdepth || AUTOPAR_createtasknbr) {\n\tAUTOPAR_nbdepth=AUTOPAR_lnbdepth+1;\n}\n\n", true, true);
-        RW.InsertText(FCall->getEndLoc().getLocWithOffset(2), "\n\nif (AUTOPAR_createtasknbr) {\n\t#pragma omp atomic\n\tAUTOPAR_nbtask--;\n}\n", true, true);
-        RW.InsertText(FCall->getEndLoc().getLocWithOffset(2), "}\n", true, true);
+        TaskPlan plan = planTask(depInfo, FCall);
+        RW.InsertText(FCall->getBeginLoc(), taskBegin(plan), true, true);
+        RW.InsertText(FCall->getEndLoc().getLocWithOffset(2), taskEnd(plan, serialText), true, true);
 
-        addTask(depInfo);
+        addTask(depInfo, CalledFunc, FCall);
+        addSpawn(FCall);
+    }
+
+    if (ParallelStd) {
+        parallelizeStdCall(FCall);
     }
 
     if (ignoreCalls > 0)
@@ -122,6 +141,7 @@ bool TaskCreationVisitor::VisitCallExpr(CallExpr *FCall) {
 bool TaskCreationVisitor::VisitFunctionDecl(FunctionDecl *f) {
     if (!isFromMainFile(f->getLocation())) return true;
     if (!f->isDefined()) return true;
+    llvm::TimeTraceScope TimeScope("VisitFunctionDecl");
 
     Stmt *FuncBody = f->getBody();
     std::string FuncName = f->getNameInfo().getName().getAsString();
@@ -129,24 +149,104 @@ bool TaskCreationVisitor::VisitFunctionDecl(FunctionDecl *f) {
     bool taskCreated = checkTaskCreation(FuncBody);
     currentFunction = f;
 
+    memoized = Memoize && canMemoize(f, AC);
+    if (memoized) {
+        llvm::outs() << "Memoizing " << FuncName << "\n";
+        RW.InsertText(FuncBody->getBeginLoc().getLocWithOffset(1), getMemoPrologue(f, AC), true, true);
+    }
+
+    cancellable = false;
+    cancellingReturns.clear();
+    slots.clear();
+
+    bool entryPoint = Backend == BackendKind::OpenMP && isEntryPoint(f);
+
     if (!taskCreated) {
+        if (entryPoint && !EntryPoints.empty()) {
+            llvm::outs() << "Library: " << FuncName << " creates no tasks, it starts no team\n";
+        }
         return true;
     }
 
+    if (Cancel) {
+        Cancellation cancellation = analyzeCancellation(f, AC);
+        SourceManager &SM = AC.getSourceManager();
+
+        std::string lines;
+        for (std::size_t i = 0; i < cancellation.returns.size(); ++i) {
+            lines += (i ? ", " : "") + std::to_string(SM.getPresumedLineNumber(cancellation.returns[i]->getBeginLoc()));
+        }
+
+        if (cancellation.returns.empty()) {
+            /* nothing is pending when it returns */
+        } else if (Backend != BackendKind::OpenMP) {
+            llvm::outs() << "Cancellation: " << FuncName << " waits for its tasks at line " << lines << ": only the OpenMP backend cancels tasks\n";
+        } else if (!cancellation.legal) {
+            llvm::outs() << "Cancellation: " << FuncName << " waits for its tasks at line " << lines << ": " << cancellation.reason << "\n";
+        } else {
+            cancellable = true;
+            cancellingReturns.insert(cancellation.returns.begin(), cancellation.returns.end());
+            stats.cancellingReturns += cancellation.returns.size();
+
+            /* declared before the taskgroup, so that it counts the discarded tasks after the taskgroup has ended */
+            RW.InsertText(FuncBody->getBeginLoc().getLocWithOffset(1), "\nAUTOPAR_CancelGroup AUTOPAR_cgroup;", false, true);
+            llvm::outs() << "Cancellation: " << FuncName << " cancels its pending tasks when returning at line " << lines
+                         << ", which needs OMP_CANCELLATION=true at run time\n";
+        }
+    }
+
     if (returnTypeStr != "void") {
         RW.InsertText(FuncBody->getBeginLoc().getLocWithOffset(1), "\n" + returnTypeStr + " AUTOPAR_res;\n", true, true);
     }
 
-    if (FuncName == "main") {
+    /* the work-stealing scheduler starts its threads by itself */
+    if (FuncName == "main" && Backend == BackendKind::OpenMP) {
         RW.InsertText(FuncBody->getBeginLoc().getLocWithOffset(1), "\n#pragma omp parallel\n#pragma omp master", true, true);
     }
 
+    /* the returns are gotos to the end of the taskgroup, so the taskgroup can run in a lambda */
+    if (entryPoint) {
+        RW.InsertText(FuncBody->getBeginLoc().getLocWithOffset(1), "\nAUTOPAR_InTeam([&] {", true, true);
+        stats.entryPoints++;
+        llvm::outs() << "Library: " << FuncName << " starts a team when called outside of a parallel region\n";
+    }
+
     addFunction(FuncName);
     llvm::outs() << "Parallelizing " << FuncName << "\n";
-    RW.InsertText(FuncBody->getBeginLoc().getLocWithOffset(1), "\n#pragma omp taskgroup\n{\n\n" + AUTOPAR_TASK_LIMITER_CODE_TASKGROUP + "\n", true, true);
 
-    std::string endLabel = "\nAUTOPAR_endtaskgrouplabel_" + FuncName + ": ;\n}\n";
-    if (returnTypeStr != "void") {
+    /* probes and tuners live in an enclosing block so that they also time the wait at the end of the taskgroup */
+    std::string groupPrologue;
+    if (isInstrumented()) {
+        int site = addSite("taskgroup", f->getQualifiedNameAsString(), FuncBody->getBeginLoc());
+        groupPrologue += "\nAUTOPAR_TaskProbe AUTOPAR_gprobe(" + std::to_string(site) + ");";
+    }
+    if (Adaptive) {
+        groupPrologue += "\nstatic AUTOPAR_Tuner AUTOPAR_tuner;"
+                         "\nAUTOPAR_TuneScope AUTOPAR_tscope(AUTOPAR_tuner);"
+                         "\nconst int AUTOPAR_maxdepth = AUTOPAR_tuner.depth();"
+                         "\nconst int AUTOPAR_maxtask = AUTOPAR_tuner.nbtasks();";
+    }
+    if (!groupPrologue.empty()) {
+        groupPrologue = "\n{" + groupPrologue;
+    }
+
+    std::string taskGroup = Backend == BackendKind::WorkStealing
+        ? "\n{\nautopar_ws::TaskGroup AUTOPAR_group;\n\n"
+        : "\n#pragma omp taskgroup\n{\n\n";
+
+    /* the body keeps its own block, so that the returns jump out of the scope of its declarations rather than over them */
+    RW.InsertText(FuncBody->getBeginLoc().getLocWithOffset(1), groupPrologue + taskGroup + AUTOPAR_TASK_LIMITER_CODE_TASKGROUP + "\n{\n", true, true);
+
+    std::string endLabel = "\n}\nAUTOPAR_endtaskgrouplabel_" + FuncName + ": ;\n}\n";
+    if (!groupPrologue.empty()) {
+        endLabel += "}\n";
+    }
+    if (entryPoint) {
+        endLabel += "});\n";
+    }
+    if (memoized) {
+        endLabel += "return AUTOPAR_memo.store(AUTOPAR_key, AUTOPAR_res);\n";
+    } else if (returnTypeStr != "void") {
         endLabel += "return AUTOPAR_res;\n";
     }
 
@@ -160,6 +260,9 @@ bool TaskCreationVisitor::VisitExpr(Expr *e) {
     if (!(isa<BinaryOperator>(e) || isa<UnaryOperator>(e))) {
         return true;
     }
+    llvm::TimeTraceScope TimeScope("VisitExpr");
+
+    if (isDecomposed(e) || decomposeCalls(e, e, nullptr)) return true;
 
     const Stmt *curr = e;
     int nbCallExprs = countCallExprs(curr);
@@ -170,21 +273,20 @@ bool TaskCreationVisitor::VisitExpr(Expr *e) {
         for (auto *Child : curr->children()) {
             if (Child) {
                 if (auto *FCall = llvm::dyn_cast<CallExpr>(Child)) {
-                    const FunctionDecl *CalledFunc = FCall->getDirectCallee();
-                    if (CalledFunc && CalledFunc->isDefined() && !CalledFunc->isStdNamespace() && CalledFunc->getIdentifier()) {
+                    if (const FunctionDecl *CalledFunc = getTaskCallee(FCall)) {
                         DependInfo depInfo = getFCallDependencies(CalledFunc, FCall, RW);
-                        std::string depClause = constructDependClause(depInfo);
+                        std::string serialText = RW.getRewrittenText(e->getSourceRange()) + ";";
 
                         if (shouldAddTaskWait(depInfo)) {
-                            RW.InsertText(e->getBeginLoc(), "#pragma omp taskwait\n\n", true, true);
+                            RW.InsertText(e->getBeginLoc(), taskWait(e->getBeginLoc()) + "\n\n", true, true);
                         }
 
-                        RW.InsertText(e->getBeginLoc(), AUTOPAR_PRE_TASK + std::string("\n#pragma omp task ").append(depClause).append(" ").append(AUTOPAR_TASK_CLAUSE).append("\n{\n"), true, true);
-                        RW.InsertText(e->getBeginLoc(), "if (AUTOPAR_createtaskdepth || AUTOPAR_createtasknbr) {\n\tAUTOPAR_nbdepth=AUTOPAR_lnbdepth+1;\n}\n\n", true, true);
-                        RW.InsertText(e->getEndLoc().getLocWithOffset(2), "\n\nif (AUTOPAR_createtasknbr) {\n\t#pragma omp atomic\n\tAUTOPAR_nbtask--;\n}\n", true, true);
-                        RW.InsertText(e->getEndLoc().getLocWithOffset(2), "}\n", true, true);
+                        TaskPlan plan = planTask(depInfo, FCall);
+                        RW.InsertText(e->getBeginLoc(), taskBegin(plan), true, true);
+                        RW.InsertText(e->getEndLoc().getLocWithOffset(2), taskEnd(plan, serialText), true, true);
 
-                        addTask(depInfo);
+                        addTask(depInfo, CalledFunc, FCall);
+                        addSpawn(e);
                     }
                 }
             }
@@ -194,9 +296,12 @@ bool TaskCreationVisitor::VisitExpr(Expr *e) {
 
         if (shouldAddTaskWait(vars)) {
             if (auto parent = getParentIfLoop(e, AC)) {
-                RW.InsertText(parent->getBeginLoc(), "\n#pragma omp taskwait\n", true, true);
+                if (!isDeclaredBefore(waitFor, e, parent->getBeginLoc())) {
+                    waitFor.clear();
+                }
+                RW.InsertText(parent->getBeginLoc(), "\n" + taskWait(parent->getBeginLoc()) + "\n", true, true);
             } else {
-                RW.InsertText(e->getBeginLoc(), "\n#pragma omp taskwait\n", true, true);
+                RW.InsertText(e->getBeginLoc(), "\n" + taskWait(e->getBeginLoc()) + "\n", true, true);
             }
         }
     }
@@ -206,30 +311,117 @@ bool TaskCreationVisitor::VisitExpr(Expr *e) {
 
 bool TaskCreationVisitor::VisitReturnStmt(ReturnStmt *ret) {
     if (!isFromMainFile(ret->getReturnLoc())) return true;
+    llvm::TimeTraceScope TimeScope("VisitReturnStmt");
 
     if (!currentFunction) {
         llvm::errs() << "Error: VisitReturnStmt() no current function\n";
     }
 
-    if (!checkTaskCreation(currentFunction->getBody())) return true;
+    if (!checkTaskCreation(currentFunction->getBody())) {
+        if (memoized && ret->getRetValue()) {
+            SourceRange range = ret->getRetValue()->getSourceRange();
+            RW.ReplaceText(range, "AUTOPAR_memo.store(AUTOPAR_key, " + RW.getRewrittenText(range) + ")");
+        }
+        return true;
+    }
 
     std::string assignTxt = "\n";
 
     Expr *retValue = ret->getRetValue();
-    std::string gotoTxt = "goto AUTOPAR_endtaskgrouplabel_" + currentFunction->getNameAsString();
+    std::string gotoTxt = "goto AUTOPAR_endtaskgrouplabel_" + currentFunction->getNameAsString() + ";";
     if (retValue) {
-        gotoTxt += ";";
         assignTxt += "AUTOPAR_res = " + RW.getRewrittenText(retValue->getSourceRange()) + ";\n";
     }
 
+    SourceManager &SM = AC.getSourceManager();
     SourceLocation begin = ret->getBeginLoc();
-    SourceLocation end = ret->getEndLoc().getLocWithOffset(1);
+    SourceLocation end = Lexer::findLocationAfterToken(ret->getEndLoc(), tok::semi, SM, AC.getLangOpts(), false);
+    if (end.isInvalid()) return true;
 
-    auto lineText = Lexer::getIndentationForLine(begin, AC.getSourceManager());
+    auto lineText = Lexer::getIndentationForLine(begin, SM);
     auto indentation = lineText.substr(0, lineText.find_first_not_of(" \t"));
 
-    SourceRange range(begin, end);
-    RW.ReplaceText(range, indentation.str() + assignTxt + indentation.str() + gotoTxt);
+    /* the tasks still pending only compute local variables, which die with the function */
+    if (cancellingReturns.count(ret)) {
+        gotoTxt = "AUTOPAR_CancelTaskgroup();\n" + indentation.str() + gotoTxt;
+    }
+
+    /* a block, since the return may be the whole branch of an if or the body of a loop */
+    RW.ReplaceText(begin, SM.getFileOffset(end) - SM.getFileOffset(begin),
+        "{" + assignTxt + indentation.str() + gotoTxt + "\n" + indentation.str() + "}");
+
+    return true;
+}
+
+/*
+innermost loops are vectorized when no iteration depends on another one closer than the vector length.
+Reductions into anything but a variable are accumulated in a local, written back after the loop
+*/
+bool TaskCreationVisitor::VisitForStmt(ForStmt *loop) {
+    if (!Simd || !isFromMainFile(loop->getBeginLoc()) || loop->getBeginLoc().isMacroID()) return true;
+    if (!isInnermostLoop(loop)) return true;
+    llvm::TimeTraceScope TimeScope("VisitForStmt");
+
+    SimdLoop simd = analyzeSimdLoop(loop, AC, RW);
+    unsigned line = AC.getSourceManager().getPresumedLineNumber(loop->getBeginLoc());
+
+    bool accumulates = false;
+    for (const SimdReduction &reduction : simd.reductions) {
+        accumulates |= !reduction.variable;
+    }
+
+    SourceLocation end = getLoopEnd(loop, AC);
+    if (simd.legal && accumulates && end.isInvalid()) {
+        simd.legal = false;
+        simd.reason = "the end of the loop cannot be located";
+    }
+
+    if (!simd.legal) {
+        stats.simdRejected++;
+        llvm::outs() << "SIMD: rejected loop at line " << line << ": " << simd.reason << "\n";
+        return true;
+    }
+
+    std::string clauses;
+    std::string accumulators;
+    std::string writeBack;
+
+    for (const SimdReduction &reduction : simd.reductions) {
+        std::string name = reduction.target;
+
+        if (!reduction.variable) {
+            name = "AUTOPAR_simd" + std::to_string(simdAccumulators++);
+            accumulators += reduction.type + " " + name + " = " + (reduction.op == "*" ? "1" : "0") + ";\n";
+            writeBack += "\n" + reduction.target + " " + reduction.op + "= " + name + ";";
+
+            for (const Expr *update : reduction.updates) {
+                RW.ReplaceText(update->getSourceRange(), name);
+            }
+        }
+
+        clauses += " reduction(" + reduction.op + ": " + name + ")";
+    }
+
+    if (simd.safelen) {
+        clauses += " safelen(" + std::to_string(simd.safelen) + ")";
+    }
+    for (const std::string &aligned : simd.aligned) {
+        clauses += " aligned(" + aligned + ")";
+    }
+
+    if (accumulators.empty()) {
+        RW.InsertText(loop->getBeginLoc(), "\n#pragma omp simd" + clauses + "\n", true, true);
+    } else {
+        RW.InsertText(loop->getBeginLoc(), "{\n" + accumulators + "#pragma omp simd" + clauses + "\n", true, true);
+        RW.InsertText(end, writeBack + "\n}", true, true);
+    }
+
+    stats.simdLoops++;
+    llvm::outs() << "SIMD: vectorized loop at line " << line;
+    for (const std::string &assumption : simd.assumptions) {
+        llvm::outs() << " (" << assumption << ")";
+    }
+    llvm::outs() << "\n";
 
     return true;
 }
@@ -241,18 +433,27 @@ bool TaskCreationVisitor::VisitReturnStmt(ReturnStmt *ret) {
 void TaskCreationVisitor::addFunction(std::string funcName) {
     taskId = 0;
     awaited.clear();
+    pureCalls.clear();
     Function curr;
     curr.name = std::move(funcName);
     curr.id = funcId++;
     functions.push_back(curr);
+    stats.functions++;
 }
 
-void TaskCreationVisitor::addTask(DependInfo depInfo) {
+void TaskCreationVisitor::addTask(DependInfo depInfo, const FunctionDecl *callee, const CallExpr *FCall) {
     Task curr;
+    SourceManager &SM = AC.getSourceManager();
 
     curr.depInfo = std::move(depInfo);
     curr.id = taskId++;
+    curr.callee = callee ? callee->getQualifiedNameAsString() : "statement";
+    curr.line = SM.getPresumedLineNumber(SM.getExpansionLoc(FCall->getBeginLoc()));
+    if (callee && !TaskGraphDir.empty()) {
+        curr.cost = estimateCost(callee, AC);
+    }
     functions.back().tasks.push_back(curr);
+    stats.tasks++;
 }
 
 bool TaskCreationVisitor::shouldAddTaskWait(const DependInfo& depInfo) {
@@ -262,12 +463,14 @@ bool TaskCreationVisitor::shouldAddTaskWait(const DependInfo& depInfo) {
         for (const auto& var : depInfo.read) {
             if (task.depInfo.write.count(var) && !awaited.count(var)) {
                 awaited.insert(var);
+                waitFor.insert(var);
                 res = true;
             }
         }
         for (const auto& var : depInfo.write) {
             if (task.depInfo.write.count(var) && !awaited.count(var)) {
                 awaited.insert(var);
+                waitFor.insert(var);
                 res = true;
             }
         }
@@ -276,6 +479,469 @@ bool TaskCreationVisitor::shouldAddTaskWait(const DependInfo& depInfo) {
     return res;
 }
 
+/* the declaration statement of `var`, if the value of its type may need to be destroyed at the end of its block */
+const DeclStmt *TaskCreationVisitor::getSlotScope(const VarDecl *var) {
+    QualType type = var->getType().getNonReferenceType();
+    if (!type->isDependentType() && !type.isDestructedType()) return nullptr;
+
+    auto parents = AC.getParentMapContext().getParents(*var);
+    return parents.empty() ? nullptr : parents[0].get<DeclStmt>();
+}
+
+/*
+whether the declaration of `var` can become a reference to a result slot: it doesn't bind a reference to an
+existing object, which can't be delayed, its type can be named at the start of the function, and a value
+with a destructor is declared by a statement of a block, at the end of which it is destroyed
+*/
+bool TaskCreationVisitor::canDeclareResultSlot(const VarDecl *var) {
+    QualType type = var->getType();
+    const Expr *init = var->getInit();
+
+    if (type->isReferenceType()) {
+        if (const auto *cleanups = llvm::dyn_cast<ExprWithCleanups>(init)) init = cleanups->getSubExpr();
+        if (!llvm::isa<MaterializeTemporaryExpr>(init)) return false;
+        type = type.getNonReferenceType();
+    }
+
+    if (!currentFunction || var->getParentFunctionOrMethod() != currentFunction) return false;
+
+    /* dependent types name template parameters, unless they are deduced or refer to a local through decltype */
+    if (type->isDependentType()) {
+        std::string declared = RW.getRewrittenText(var->getTypeSourceInfo()->getTypeLoc().getSourceRange());
+        if (type->getContainedDeducedType() || declared.find("decltype") != std::string::npos) return false;
+    } else if (!isHoistableType(type)) {
+        return false;
+    }
+
+    if (type->isDependentType() || type.isDestructedType()) {
+        const DeclStmt *scope = getSlotScope(var);
+        return scope && getBlockStatement(scope, AC);
+    }
+    return true;
+}
+
+/*
+the task constructs the result in an AUTOPAR_Slot, and the variable becomes a reference to it with the
+declared constness. The slot is declared at the start of the function, before the taskgroup, since the
+taskgroup only waits for its tasks once the locals of its block are destroyed. A value with a destructor
+is still destroyed at the end of the block of the declaration, by a scope object declared after it.
+Returns the statement constructing the result, or an empty string when canDeclareResultSlot rejects it
+*/
+std::string TaskCreationVisitor::declareResultSlot(const VarDecl *var, std::string value) {
+    if (!canDeclareResultSlot(var)) return "";
+
+    QualType type = var->getType().getNonReferenceType();
+    const DeclStmt *scoped = getSlotScope(var);
+
+    bool isConst = type.isConstQualified();
+    type.removeLocalConst();
+
+    /* the slots of variables with the same name in different blocks all live in the function */
+    std::string varName = var->getNameAsString();
+    std::string slot = "AUTOPAR_slot_" + varName;
+    if (!slots.insert(slot).second) {
+        slot += "_" + std::to_string(slots.size());
+        slots.insert(slot);
+    }
+
+    std::string typeName = type.getAsString(AC.getPrintingPolicy());
+    if (value.empty()) {
+        value = RW.getRewrittenText(var->getInit()->getSourceRange());
+    }
+
+    RW.InsertText(currentFunction->getBody()->getBeginLoc().getLocWithOffset(1), "\nAUTOPAR_Slot<" + typeName + "> " + slot + ";", false, true);
+    RW.ReplaceText(var->getSourceRange(), (isConst ? "const " : "") + typeName + " &" + varName + " = " + slot + ".get()");
+
+    if (scoped) {
+        std::string scope = "AUTOPAR_scope_" + slot.substr(std::string("AUTOPAR_slot_").size());
+        std::string declaration = Backend == BackendKind::WorkStealing
+            ? "autopar_ws::SlotScope<" + typeName + "> " + scope + "(AUTOPAR_group, " + slot + ");"
+            : "AUTOPAR_SlotScope<" + typeName + "> " + scope + "(" + slot + ");";
+        RW.InsertText(scoped->getEndLoc().getLocWithOffset(1), "\n" + declaration, true, true);
+    }
+
+    return slot + ".construct([&] { return " + value + "; });";
+}
+
+/* statement of a block creating tasks, which --early-spawn may move */
+void TaskCreationVisitor::addSpawn(const Stmt *s) {
+    if (!EarlySpawn) return;
+
+    const Stmt *stmt = getBlockStatement(s, AC);
+    if (stmt && (spawns.empty() || spawns.back() != stmt)) {
+        spawns.push_back(stmt);
+    }
+}
+
+/* calls of standard algorithms on random-access ranges are redirected to their task-parallel versions in the runtime */
+void TaskCreationVisitor::parallelizeStdCall(const CallExpr *FCall) {
+    StdAlgorithmCall call = analyzeStdAlgorithmCall(FCall, AC);
+    if (call.algorithm.empty()) return;
+
+    unsigned line = AC.getSourceManager().getPresumedLineNumber(FCall->getBeginLoc());
+
+    if (!call.legal) {
+        stats.parallelStdRejected++;
+        llvm::outs() << "Parallel std: rejected " << call.algorithm << " at line " << line << ": " << call.reason << "\n";
+        return;
+    }
+
+    /* the threshold is a template argument, so that the overloads stay those of the algorithm */
+    RW.ReplaceText(FCall->getCallee()->getSourceRange(), call.replacement + "<" + std::to_string(ParallelStdMinSize) + ">");
+
+    stats.parallelStdCalls++;
+    llvm::outs() << "Parallel std: " << call.algorithm << " at line " << line << " runs in tasks\n";
+}
+
+bool TaskCreationVisitor::isDecomposed(const Stmt *s) {
+    SourceManager &SM = AC.getSourceManager();
+
+    for (const Stmt *stmt : decomposed) {
+        if (SM.isPointWithin(s->getBeginLoc(), stmt->getBeginLoc(), stmt->getEndLoc())) return true;
+    }
+    return false;
+}
+
+/*
+the calls of user functions nested in the expression of a statement are evaluated by sibling tasks into
+temporaries declared at the start of the function, each one depending on the temporaries of its arguments.
+The statement then reads the temporaries in a last task, or in the task of the declaration it initializes
+*/
+bool TaskCreationVisitor::decomposeCalls(Stmt *stmt, Expr *root, const VarDecl *var) {
+    if (ignoreCalls > 0 || functions.empty() || !currentFunction || stmt->getBeginLoc().isMacroID()) return false;
+    /* checked before anything is rewritten, the declaration can't be left serial once its calls are tasks */
+    if (var && (!isHoistableType(var->getType()) || !canDeclareResultSlot(var))) return false;
+
+    SourceManager &SM = AC.getSourceManager();
+    Stmt *body = currentFunction->getBody();
+    if (!SM.isPointWithin(stmt->getBeginLoc(), body->getBeginLoc(), body->getEndLoc())) return false;
+
+    /* only statements of a block, so that tasks can be placed before them */
+    if (!getBlockStatement(stmt, AC)) return false;
+
+    const auto *rootCall = llvm::dyn_cast<CallExpr>(root->IgnoreImplicit());
+    if (rootCall && !getTaskCallee(rootCall)) rootCall = nullptr;
+
+    Decomposition d;
+    if (!decomposeExpr(root, rootCall, d)) return false;
+
+    /* MUST BE BEFORE REWRITING */
+    std::vector<DependInfo> deps;
+    for (const CallExpr *call : d.calls) {
+        DependInfo depInfo = getFCallDependencies(getTaskCallee(call), call, RW);
+        if (!depInfo.instanceGuard.empty()) return false;
+        removeFunctionNames(depInfo, call);
+        deps.push_back(depInfo);
+    }
+
+    DependInfo statement = getStatementDependencies(root, d, RW);
+    if (!statement.instanceGuard.empty()) return false;
+    if (var) {
+        statement.write.insert(var->getNameAsString());
+    }
+
+    bool wait = false;
+    for (const DependInfo &depInfo : deps) {
+        wait = shouldAddTaskWait(depInfo) || wait;
+    }
+    wait = shouldAddTaskWait(statement) || wait;
+
+    std::string prefix = wait ? taskWait(stmt->getBeginLoc()) + "\n" : "";
+    std::string temporaries;
+    std::vector<std::string> names;
+
+    for (std::size_t i = 0; i < d.calls.size(); ++i) {
+        const CallExpr *call = d.calls[i];
+        std::string name = "AUTOPAR_tmp_" + std::to_string(tmpId++);
+        names.push_back(name);
+
+        deps[i].write.insert(name);
+        for (int input : d.inputs[i]) {
+            deps[i].read.insert(names[input]);
+        }
+
+        std::string type = call->getType().getCanonicalType().getUnqualifiedType().getAsString(AC.getPrintingPolicy());
+        temporaries += "\nAUTOPAR_Slot<" + type + "> " + name + ";";
+
+        std::string construct = name + ".construct([&] { return " + RW.getRewrittenText(call->getSourceRange()) + "; });";
+        RW.ReplaceText(call->getSourceRange(), name + ".take()");
+
+        TaskPlan plan = planTask(deps[i], call);
+        prefix += taskBegin(plan) + construct + taskEnd(plan, construct) + "\n";
+        addTask(deps[i], getTaskCallee(call), call);
+    }
+
+    for (int input : d.finalInputs) {
+        statement.read.insert(names[input]);
+    }
+
+    /* before the taskgroup, which only waits for the tasks once its locals are destroyed */
+    RW.InsertText(body->getBeginLoc().getLocWithOffset(1), temporaries + "\n", false, true);
+
+    TaskPlan plan = planTask(statement, d.root);
+    const CallExpr *site = d.root ? d.root : d.calls.back();
+
+    if (var) {
+        std::string initializer = declareResultSlot(var);
+        RW.InsertText(stmt->getBeginLoc(), prefix, false, true);
+        RW.InsertText(stmt->getEndLoc().getLocWithOffset(1), taskBegin(plan) + initializer + taskEnd(plan, initializer), true, true);
+    } else {
+        SourceLocation end = Lexer::findLocationAfterToken(stmt->getEndLoc(), tok::semi, SM, AC.getLangOpts(), false);
+        if (end.isInvalid()) end = stmt->getEndLoc().getLocWithOffset(2);
+
+        std::string serialText = RW.getRewrittenText(SourceRange(stmt->getBeginLoc(), end.getLocWithOffset(-1)));
+        RW.InsertText(stmt->getBeginLoc(), prefix + taskBegin(plan), false, true);
+        RW.InsertText(end, taskEnd(plan, serialText), true, true);
+    }
+
+    addTask(statement, d.root ? getTaskCallee(d.root) : nullptr, site);
+    addSpawn(stmt);
+
+    llvm::outs() << "Decomposing " << d.calls.size() << " nested calls at line " << SM.getPresumedLineNumber(stmt->getBeginLoc()) << "\n";
+    stats.decomposedCalls += d.calls.size();
+    decomposed.push_back(stmt);
+
+    return true;
+}
+
+/*
+the variable of an earlier identical pure call is copied by a task depending on it. Writes to that
+variable after the copy must wait for it, so the variable is no longer considered awaited
+*/
+bool TaskCreationVisitor::reusePureCall(const PureCall &earlier, const VarDecl *var, DeclStmt *DeclStat, const CallExpr *FCall) {
+    std::string source = earlier.result->getNameAsString();
+    std::string varName = var->getNameAsString();
+
+    std::string initializer = declareResultSlot(var, source);
+    if (initializer.empty()) return false;
+
+    SourceManager &SM = AC.getSourceManager();
+    llvm::outs() << "Pure: reusing " << getPureCallText(earlier) << " of line " << SM.getPresumedLineNumber(earlier.decl->getBeginLoc())
+                 << " for " << varName << " at line " << SM.getPresumedLineNumber(DeclStat->getBeginLoc()) << "\n";
+
+    DependInfo depInfo;
+    depInfo.read.insert(source);
+    depInfo.write.insert(varName);
+
+    TaskPlan plan = planTask(depInfo, FCall);
+    RW.InsertText(DeclStat->getEndLoc().getLocWithOffset(1),
+        taskBegin(plan) + initializer + taskEnd(plan, initializer),
+        true, true);
+
+    addTask(depInfo, earlier.callee, FCall);
+    functions.back().tasks.back().callee = "copy of " + source;
+    functions.back().tasks.back().cost = 0;
+    awaited.erase(source);
+    stats.reusedCalls++;
+    addSpawn(DeclStat);
+
+    return true;
+}
+
+/*
+pages are placed on the NUMA node of the thread touching them first. A large allocation initialized
+by a serial loop is touched in parallel before, either right after the declaration or by the allocator
+of a vector, since the vector constructor already writes every element
+*/
+void TaskCreationVisitor::placeFirstTouch(DeclStmt *DeclStat) {
+    FirstTouchSite site = findFirstTouchSite(DeclStat, AC, RW);
+    if (site.kind == FirstTouchSite::None) return;
+
+    std::string name = site.var->getNameAsString();
+
+    if (site.kind == FirstTouchSite::Vector) {
+        std::string element = site.element.getAsString(AC.getPrintingPolicy());
+        RW.ReplaceText(site.var->getTypeSourceInfo()->getTypeLoc().getSourceRange(),
+            "std::vector<" + element + ", AUTOPAR_FirstTouchAllocator<" + element + ">>");
+    } else {
+        RW.InsertText(DeclStat->getEndLoc().getLocWithOffset(1), "\nAUTOPAR_FirstTouch(" + name + ", " + site.bytes + ");\n", true, true);
+    }
+
+    llvm::outs() << "First touch: " << name << " at line " << AC.getSourceManager().getPresumedLineNumber(DeclStat->getBeginLoc()) << "\n";
+}
+
+/* a task not created yet may touch the same variables as this call */
+bool TaskCreationVisitor::conflictsWithTasks(const DependInfo& depInfo) {
+    if (functions.size() == 0) return false;
+
+    for (const auto& task : functions.back().tasks) {
+        for (const auto& var : depInfo.write) {
+            if (task.depInfo.write.count(var) || task.depInfo.read.count(var)) return true;
+        }
+        for (const auto& var : depInfo.read) {
+            if (task.depInfo.write.count(var)) return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+decides how a call site becomes a task: under the limiter, guarded when the dependencies only hold
+for some dynamic types, and, with --profile, with the cutoff or serialization the recorded task
+durations call for
+*/
+TaskPlan TaskCreationVisitor::planTask(const DependInfo &depInfo, const CallExpr *FCall) {
+    TaskPlan plan;
+    plan.depInfo = depInfo;
+    plan.condition = AUTOPAR_TASK_CONDITION;
+
+    if (!depInfo.guard.empty()) {
+        plan.condition = "(" + plan.condition + ") && " + depInfo.guard;
+    }
+
+    /* the statement of a decomposed expression is neither profiled nor probed */
+    if (!FCall) return plan;
+
+    const FunctionDecl *CalledFunc = getTaskCallee(FCall);
+    std::string callee = CalledFunc ? CalledFunc->getQualifiedNameAsString() : "";
+    PresumedLoc presumed = AC.getSourceManager().getPresumedLoc(AC.getSourceManager().getExpansionLoc(FCall->getBeginLoc()));
+
+    if (!ProfileFile.empty() && presumed.isValid()) {
+        if (const SiteProfile *profile = TaskProfile::get().lookup(presumed.getFilename(), presumed.getLine(), presumed.getColumn())) {
+            SiteDecision decision = decideSite(*profile, ProfileMinTaskNs);
+            std::string where = callee + " at line " + std::to_string(presumed.getLine());
+
+            if (decision.kind == SiteDecision::Serialize && !conflictsWithTasks(depInfo)) {
+                llvm::outs() << "Profile: serializing " << where << "\n";
+                plan.serial = true;
+                return plan;
+            } else if (decision.kind == SiteDecision::Serialize) {
+                /* an undeferred task still waits for the tasks it depends on */
+                llvm::outs() << "Profile: inlining " << where << "\n";
+                plan.condition = "0";
+            } else if (decision.kind == SiteDecision::Cutoff) {
+                llvm::outs() << "Profile: cutoff at depth " << decision.depth << " for " << where << "\n";
+                plan.condition = "(" + plan.condition + ") && AUTOPAR_lnbdepth < " + std::to_string(decision.depth);
+            }
+        }
+    }
+
+    /* OpenMP 5 affinity, the work-stealing scheduler has no notion of places */
+    if (Numa && Backend == BackendKind::OpenMP && !depInfo.affinity.empty()) {
+        plan.affinity = "affinity(" + depInfo.affinity + ") ";
+    }
+
+    if (isInstrumented()) {
+        plan.site = addSite("task", callee, FCall->getBeginLoc());
+    }
+
+    return plan;
+}
+
+/* opening of a task, only compiled in the template instantiations where the call is a task */
+std::string TaskCreationVisitor::taskBegin(const TaskPlan &plan) {
+    if (plan.serial) return "";
+
+    std::string text;
+
+    if (!plan.depInfo.instanceGuard.empty()) {
+        text += "if constexpr (" + plan.depInfo.instanceGuard + ") {\n";
+    }
+
+    text += cancellable ? AUTOPAR_PRE_CANCELLABLE_TASK : AUTOPAR_PRE_TASK;
+
+    std::string prologue = AUTOPAR_TASK_PROLOGUE;
+    if (plan.site >= 0) {
+        std::string site = std::to_string(plan.site);
+        text += "\nAUTOPAR_SpawnProbe(" + site + ", " + plan.condition + ");";
+        prologue = "AUTOPAR_TaskProbe AUTOPAR_probe(" + site + ", AUTOPAR_lnbdepth);\n" + prologue;
+    }
+    if (cancellable) {
+        prologue = AUTOPAR_TASK_CANCELLATION_POINT + prologue;
+    }
+
+    if (Backend == BackendKind::WorkStealing) {
+        return text + "\nAUTOPAR_group.spawn(" + plan.condition + ", " + constructDependList(plan.depInfo)
+            + ", [&, AUTOPAR_lnbdepth]() {\n" + prologue;
+    }
+
+    return text + "\n#pragma omp task " + constructDependClause(plan.depInfo) + " " + plan.affinity
+        + "firstprivate(AUTOPAR_lnbdepth) if(" + plan.condition + ") default(shared)\n{\n"
+        + prologue;
+}
+
+/* closing of a task, `serialText` runs in the other template instantiations */
+std::string TaskCreationVisitor::taskEnd(const TaskPlan &plan, const std::string &serialText) {
+    if (plan.serial) return "";
+
+    std::string text = AUTOPAR_TASK_EPILOGUE + (Backend == BackendKind::WorkStealing ? "});\n" : "}\n");
+
+    if (!plan.depInfo.instanceGuard.empty()) {
+        text += "} else {\n" + serialText + "\n}\n";
+    }
+
+    return text;
+}
+
+/* inserted barrier, timed in its own block when instrumented */
+std::string TaskCreationVisitor::taskWait(SourceLocation loc) {
+    std::string wait = Backend == BackendKind::WorkStealing ? "autopar_ws::taskwait();" : "#pragma omp taskwait";
+    stats.taskwaits++;
+
+    /* a function returning early only waits for the results it reads, the other tasks may still be cancelled */
+    if (cancellable && !waitFor.empty()) {
+        std::string vars;
+        for (const auto &var : waitFor) {
+            vars += (vars.empty() ? "" : ", ") + var;
+        }
+        wait += " depend(in: " + vars + ")";
+    }
+    waitFor.clear();
+
+    barriers.push_back(loc);
+
+    if (!functions.empty()) {
+        SourceManager &SM = AC.getSourceManager();
+        functions.back().barriers.push_back({SM.getPresumedLineNumber(SM.getExpansionLoc(loc)), functions.back().tasks.size()});
+    }
+
+    if (!isInstrumented()) {
+        return wait;
+    }
+
+    int site = addSite("taskwait", "", loc);
+    return "{\nAUTOPAR_WaitProbe AUTOPAR_wprobe(" + std::to_string(site) + ");\n" + wait + "\n}";
+}
+
+/* the variables named `names` in `s` are declared before `loc`, where a wait for them is hoisted */
+bool TaskCreationVisitor::isDeclaredBefore(const std::set<std::string> &names, const Stmt *s, SourceLocation loc) {
+    std::set<std::string> declared;
+    std::vector<const Stmt *> stack = {s};
+
+    while (!stack.empty()) {
+        const Stmt *curr = stack.back();
+        stack.pop_back();
+
+        if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(curr)) {
+            const auto *var = llvm::dyn_cast<VarDecl>(ref->getDecl());
+            if (var && AC.getSourceManager().isBeforeInTranslationUnit(var->getLocation(), loc)) {
+                declared.insert(var->getNameAsString());
+            }
+        }
+        for (const Stmt *child : curr->children()) {
+            if (child) stack.push_back(child);
+        }
+    }
+
+    return std::all_of(names.begin(), names.end(), [&](const std::string &name) { return declared.count(name); });
+}
+
+/* sites are numbered in rewriting order, which only depends on the source */
+int TaskCreationVisitor::addSite(const std::string &kind, const std::string &callee, SourceLocation loc) {
+    PresumedLoc presumed = AC.getSourceManager().getPresumedLoc(AC.getSourceManager().getExpansionLoc(loc));
+    ProbeSite site;
+
+    site.kind = kind;
+    site.callee = callee;
+    site.file = presumed.isValid() ? getSitePath(presumed.getFilename()) : "";
+    site.line = presumed.isValid() ? presumed.getLine() : 0;
+    site.column = presumed.isValid() ? presumed.getColumn() : 0;
+    sites.push_back(site);
+
+    return sites.size() - 1;
+}
+
 bool TaskCreationVisitor::shouldAddTaskWait(const Vars& vars) {
     if (functions.size() == 0) return false;
     bool res = false;
@@ -283,12 +949,14 @@ bool TaskCreationVisitor::shouldAddTaskWait(const Vars& vars) {
         for (const auto& var : vars.vars) {
             if (task.depInfo.write.count(var) && !awaited.count(var)) {
                 awaited.insert(var);
+                waitFor.insert(var);
                 res = true;
             }
         }
         for (const auto& var : vars.idxs) {
             if (task.depInfo.write.count(var) && !awaited.count(var)) {
                 awaited.insert(var);
+                waitFor.insert(var);
                 res = true;
             }
         }
@@ -0,0 +1,215 @@
+#include <cancellation.hpp>
+#include <concepts.hpp>
+#include <summaries.hpp>
+
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/AST/ParentMapContext.h>
+#include <clang/AST/StmtCXX.h>
+#include <clang/Lex/Lexer.h>
+#include <llvm-18/llvm/Support/Casting.h>
+#include <set>
+
+/* a call turned into a task, with the statement the task runs and the variable receiving its result */
+struct TaskSite {
+    const CallExpr *call = nullptr;
+    const Stmt *statement = nullptr;
+    const VarDecl *result = nullptr;
+};
+
+static void
+collectSites(const Stmt *s, std::vector<const CallExpr *> &calls, std::vector<const ReturnStmt *> &returns) {
+    if (llvm::isa<LambdaExpr>(s)) return;
+
+    if (const auto *call = llvm::dyn_cast<CallExpr>(s)) {
+        if (getTaskCallee(call)) calls.push_back(call);
+    } else if (const auto *ret = llvm::dyn_cast<ReturnStmt>(s)) {
+        returns.push_back(ret);
+    }
+
+    for (const Stmt *child : s->children()) {
+        if (child) collectSites(child, calls, returns);
+    }
+}
+
+static void
+collectVariables(const Stmt *s, std::set<const VarDecl *> &vars) {
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) {
+        if (const auto *var = llvm::dyn_cast<VarDecl>(ref->getDecl())) vars.insert(var);
+    }
+
+    for (const Stmt *child : s->children()) {
+        if (child) collectVariables(child, vars);
+    }
+}
+
+/* variables whose value dies with the function */
+static bool
+isPrivateLocal(const VarDecl *var) {
+    QualType type = var->getType();
+    return var->hasLocalStorage() && !type->isReferenceType() && !type->isPointerType();
+}
+
+/* a private local variable, or an element of a private local array */
+static const VarDecl *
+getPrivateLocal(const Expr *e) {
+    e = e->IgnoreParenImpCasts();
+    while (const auto *subscript = llvm::dyn_cast<ArraySubscriptExpr>(e)) {
+        e = subscript->getBase()->IgnoreParenImpCasts();
+        if (!e->getType()->isArrayType()) return nullptr;
+    }
+
+    const auto *ref = llvm::dyn_cast<DeclRefExpr>(e);
+    const auto *var = ref ? llvm::dyn_cast<VarDecl>(ref->getDecl()) : nullptr;
+    return var && isPrivateLocal(var) ? var : nullptr;
+}
+
+/* the full expression or the declaration containing the call */
+static TaskSite
+getTaskSite(const CallExpr *call, ASTContext &AC) {
+    TaskSite site;
+    site.call = call;
+    site.statement = call;
+
+    ParentMapContext &parents = AC.getParentMapContext();
+    while (true) {
+        auto nodes = parents.getParents(*site.statement);
+        if (nodes.empty()) break;
+
+        if (const auto *parent = nodes[0].get<Expr>()) {
+            site.statement = parent;
+        } else if (const auto *var = nodes[0].get<VarDecl>()) {
+            auto decls = parents.getParents(*var);
+            if (!decls.empty() && decls[0].get<DeclStmt>()) site.statement = decls[0].get<DeclStmt>();
+            site.result = var;
+            break;
+        } else {
+            break;
+        }
+    }
+
+    const auto *full = llvm::dyn_cast<Expr>(site.statement);
+    if (const auto *binary = llvm::dyn_cast_or_null<BinaryOperator>(full ? full->IgnoreImplicit() : nullptr)) {
+        if (binary->isAssignmentOp()) site.result = getPrivateLocal(binary->getLHS());
+    }
+
+    return site;
+}
+
+static std::string
+getText(const Expr *e, ASTContext &AC) {
+    CharSourceRange range = CharSourceRange::getTokenRange(e->getSourceRange());
+    return Lexer::getSourceText(range, AC.getSourceManager(), AC.getLangOpts()).str();
+}
+
+/* discarding the task running `s` changes nothing but local variables of the function */
+static std::string
+checkDiscardable(const Stmt *s, ASTContext &AC) {
+    if (llvm::isa<LambdaExpr>(s)) return "";
+
+    std::string line = " at line " + std::to_string(AC.getSourceManager().getPresumedLineNumber(s->getBeginLoc()));
+
+    if (const auto *call = llvm::dyn_cast<CallExpr>(s)) {
+        const FunctionDecl *callee = getTaskCallee(call);
+        if (!callee) callee = call->getDirectCallee();
+        if (!callee) return "an indirect call" + line + " may have side effects";
+        if (!isPureFunction(callee, AC) && !isPureLibraryFunction(callee, AC)) return callee->getNameAsString() + line + " is not pure";
+    } else if (const auto *binary = llvm::dyn_cast<BinaryOperator>(s)) {
+        if (binary->isAssignmentOp() && !getPrivateLocal(binary->getLHS())) {
+            return getText(binary->getLHS(), AC) + line + " outlives the function";
+        }
+    } else if (const auto *unary = llvm::dyn_cast<UnaryOperator>(s)) {
+        if (unary->isIncrementDecrementOp() && !getPrivateLocal(unary->getSubExpr())) {
+            return getText(unary->getSubExpr(), AC) + line + " outlives the function";
+        }
+    } else if (const auto *construct = llvm::dyn_cast<CXXConstructExpr>(s)) {
+        if (!construct->getConstructor()->isTrivial() && !construct->getConstructor()->isConstexpr()) {
+            return "a constructor of " + construct->getType().getAsString() + line + " may have side effects";
+        }
+    } else if (const auto *decl = llvm::dyn_cast<DeclStmt>(s)) {
+        for (const Decl *d : decl->decls()) {
+            const auto *var = llvm::dyn_cast<VarDecl>(d);
+            if (var && !isPrivateLocal(var)) return var->getNameAsString() + line + " outlives the function";
+        }
+    } else if (llvm::isa<CXXNewExpr>(s) || llvm::isa<CXXDeleteExpr>(s) || llvm::isa<CXXThrowExpr>(s)) {
+        return "the statement" + line + " allocates memory or throws";
+    }
+
+    for (const Stmt *child : s->children()) {
+        if (!child) continue;
+
+        std::string reason = checkDiscardable(child, AC);
+        if (!reason.empty()) return reason;
+    }
+    return "";
+}
+
+static std::vector<const Stmt *>
+getEnclosingLoops(const Stmt *s, ASTContext &AC) {
+    std::vector<const Stmt *> loops;
+
+    ParentMapContext &parents = AC.getParentMapContext();
+    while (true) {
+        auto nodes = parents.getParents(*s);
+        if (nodes.empty() || !(s = nodes[0].get<Stmt>())) break;
+
+        if (llvm::isa<ForStmt>(s) || llvm::isa<WhileStmt>(s) || llvm::isa<DoStmt>(s) || llvm::isa<CXXForRangeStmt>(s)) {
+            loops.push_back(s);
+        }
+    }
+
+    return loops;
+}
+
+/*
+a return may leave tasks pending when a call turned into a task runs before it, earlier in the function or in
+an enclosing loop, and the returned value doesn't read its result, which would wait for it. The pending tasks
+can be discarded when they only compute local variables: their calls are pure and they assign nothing
+that outlives the function
+*/
+Cancellation
+analyzeCancellation(const FunctionDecl *FD, ASTContext &AC) {
+    Cancellation cancellation;
+    const SourceManager &SM = AC.getSourceManager();
+
+    std::vector<const CallExpr *> calls;
+    std::vector<const ReturnStmt *> returns;
+    collectSites(FD->getBody(), calls, returns);
+
+    std::vector<TaskSite> sites;
+    for (const CallExpr *call : calls) {
+        sites.push_back(getTaskSite(call, AC));
+    }
+
+    for (const ReturnStmt *ret : returns) {
+        std::set<const VarDecl *> read;
+        if (ret->getRetValue()) collectVariables(ret->getRetValue(), read);
+
+        std::vector<const Stmt *> loops = getEnclosingLoops(ret, AC);
+        bool pending = false;
+
+        for (const TaskSite &site : sites) {
+            SourceLocation loc = site.call->getBeginLoc();
+            if (SM.isPointWithin(loc, ret->getBeginLoc(), ret->getEndLoc())) continue;
+            if (site.result && read.count(site.result)) continue;
+
+            bool before = SM.isBeforeInTranslationUnit(loc, ret->getBeginLoc());
+            for (const Stmt *loop : loops) {
+                before |= SM.isPointWithin(loc, loop->getBeginLoc(), loop->getEndLoc());
+            }
+            pending |= before;
+        }
+
+        if (pending) cancellation.returns.push_back(ret);
+    }
+
+    if (cancellation.returns.empty()) return cancellation;
+
+    for (const TaskSite &site : sites) {
+        cancellation.reason = checkDiscardable(site.statement, AC);
+        if (!cancellation.reason.empty()) return cancellation;
+    }
+
+    cancellation.legal = true;
+    return cancellation;
+}
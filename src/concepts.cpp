@@ -1,15 +1,30 @@
 #include <concepts.hpp>
+#include <devirtualization.hpp>
+#include <numa.hpp>
+#include <summaries.hpp>
 #include <clang/AST/Decl.h>
 #include <clang/AST/Expr.h>
+#include <clang/AST/DeclTemplate.h>
 #include <clang/AST/ExprCXX.h>
 #include <clang/AST/ParentMapContext.h>
 #include <clang/AST/Stmt.h>
 #include <llvm-18/llvm/Support/Casting.h>
 #include <llvm-18/llvm/Support/raw_ostream.h>
+#include <llvm/Support/TimeProfiler.h>
 
 #define READ 0
 #define WRITE 1
 
+/*
+calls are taskified when the callee is a user function (not std::) whose effects on its arguments
+are known, either from its definition in this TU or from a cross-TU summary; virtual, lambda and
+function pointer calls are resolved to their possible definitions first
+*/
+const FunctionDecl *
+getTaskCallee(const CallExpr *FCall) {
+    return resolveCallTarget(FCall).callee;
+}
+
 int
 countCallExprs(const Stmt *s) {
     if (!s) return 0;
@@ -19,8 +34,7 @@ countCallExprs(const Stmt *s) {
     for (const Stmt *Child : s->children()) {
         if (Child) {
             if (const auto *FCall = llvm::dyn_cast<CallExpr>(Child)) {
-                const FunctionDecl *CalledFunc = FCall->getDirectCallee();
-                if (CalledFunc && CalledFunc->isDefined() && !CalledFunc->isStdNamespace() && CalledFunc->getIdentifier()) {
+                if (getTaskCallee(FCall)) {
                     ++count;
                 }
             }
@@ -36,8 +50,7 @@ checkTaskCreation(const Stmt *s) {
     if (!s) return false;
 
     if (const auto *FCall = llvm::dyn_cast<CallExpr>(s)) {
-        const FunctionDecl *CalledFunc = FCall->getDirectCallee();
-        if (CalledFunc && CalledFunc->isDefined() && !CalledFunc->isStdNamespace() && CalledFunc->getIdentifier()) {
+        if (getTaskCallee(FCall)) {
             return true;
         }
     }
@@ -51,17 +64,19 @@ checkTaskCreation(const Stmt *s) {
     return false;
 }
 
-DependInfo
-getFCallDependencies(const FunctionDecl *FDecl, const CallExpr *FCall, const Rewriter &RW) {
-    DependInfo depInfo;
+static void
+addParamDependencies(DependInfo &depInfo, const FunctionDecl *FDecl, const CallExpr *FCall, unsigned argOffset, const Rewriter &RW) {
+    const FunctionSummary *summary = SummaryIndex::get().lookup(FDecl);
 
-    for (unsigned i = 0; i < FDecl->getNumParams(); ++i) {
+    for (unsigned i = 0; i < FDecl->getNumParams() && i + argOffset < FCall->getNumArgs(); ++i) {
         const ParmVarDecl *Param = FDecl->getParamDecl(i);
         const QualType ParamType = Param->getType();
-        const Expr *Arg = FCall->getArg(i)->IgnoreImplicit();
+        const Expr *Arg = FCall->getArg(i + argOffset)->IgnoreImplicit();
         int depType;
 
-        if ((ParamType->isPointerType() || ParamType->isReferenceType())
+        if (summary && i < summary->params.size()) {
+            depType = summary->params[i] == ParamEffect::Write ? WRITE : READ;
+        } else if ((ParamType->isPointerType() || ParamType->isReferenceType())
             && !ParamType.isConstQualified() && !ParamType->getPointeeType().isConstQualified()) {
             depType = WRITE;
         } else {
@@ -82,6 +97,61 @@ getFCallDependencies(const FunctionDecl *FDecl, const CallExpr *FCall, const Rew
             depInfo.read.insert(idx);
         }
     }
+}
+
+static void
+addTargetDependencies(DependInfo &depInfo, const FunctionDecl *FDecl, const CallTarget &target, const CallExpr *FCall, const Rewriter &RW) {
+    /* a dispatched call may reach any of its targets, so their effects are merged */
+    if (target.targets.empty()) {
+        addParamDependencies(depInfo, FDecl, FCall, target.argOffset, RW);
+    } else {
+        for (const FunctionDecl *definition : target.targets) {
+            addParamDependencies(depInfo, definition, FCall, target.argOffset, RW);
+        }
+    }
+
+    /* the implicit object is read by const methods and possibly written by the others */
+    if (target.object && !llvm::isa<CXXThisExpr>(target.object->IgnoreParenImpCasts())) {
+        const auto *method = llvm::dyn_cast<CXXMethodDecl>(FDecl);
+        Vars vars = extractVariables(target.object->IgnoreImplicit(), RW);
+
+        for (const auto &var : vars.vars) {
+            if (method && method->isConst()) {
+                depInfo.read.insert(var);
+            } else {
+                depInfo.write.insert(var);
+            }
+        }
+
+        for (const auto &idx : vars.idxs) {
+            depInfo.read.insert(idx);
+        }
+    }
+
+    for (const VarDecl *capture : target.captures) {
+        depInfo.write.insert(capture->getNameAsString());
+    }
+}
+
+DependInfo
+getFCallDependencies(const FunctionDecl *FDecl, const CallExpr *FCall, const Rewriter &RW) {
+    llvm::TimeTraceScope TimeScope("getFCallDependencies");
+    DependInfo depInfo;
+    CallTarget target = resolveCallTarget(FCall);
+
+    /* the instantiations of a template share its source text, so their dependencies can be merged */
+    if (target.instances.empty()) {
+        addTargetDependencies(depInfo, FDecl, target, FCall, RW);
+    } else {
+        for (const CallExpr *instance : target.instances) {
+            CallTarget instanceTarget = resolveCallTarget(instance);
+            addTargetDependencies(depInfo, instanceTarget.callee, instanceTarget, instance, RW);
+        }
+    }
+
+    depInfo.guard = getTypeGuard(target, RW);
+    depInfo.instanceGuard = target.instanceGuard;
+    depInfo.affinity = getAffinityLocator(FDecl, FCall, target.argOffset, RW);
 
     return depInfo;
 }
@@ -113,8 +183,44 @@ constructDependClause(const DependInfo & depInfo) {
     return dependClause;
 }
 
+/* dependencies as the address list of autopar_ws::TaskGroup::spawn */
+std::string
+constructDependList(const DependInfo &depInfo) {
+    std::string dependList;
+
+    for (const auto &var : depInfo.read) {
+        if (depInfo.write.count(var)) continue;
+        dependList += (dependList.empty() ? "" : ", ") + std::string("autopar_ws::in(&(") + var + "))";
+    }
+
+    for (const auto &var : depInfo.write) {
+        dependList += (dependList.empty() ? "" : ", ") + std::string("autopar_ws::inout(&(") + var + "))";
+    }
+
+    return "{" + dependList + "}";
+}
+
+/* std::vector with the default allocator, the only one whose allocator can be swapped */
+bool
+isStdVector(QualType type, QualType &element) {
+    const auto *spec = llvm::dyn_cast_or_null<ClassTemplateSpecializationDecl>(type->getAsCXXRecordDecl());
+    if (!spec || spec->getName() != "vector" || !spec->isInStdNamespace()) return false;
+
+    const TemplateArgumentList &args = spec->getTemplateArgs();
+    if (args.size() < 2 || args[0].getKind() != TemplateArgument::Type || args[1].getKind() != TemplateArgument::Type) {
+        return false;
+    }
+
+    const CXXRecordDecl *allocator = args[1].getAsType()->getAsCXXRecordDecl();
+    if (!allocator || allocator->getName() != "allocator" || !allocator->isInStdNamespace()) return false;
+
+    element = args[0].getAsType();
+    return true;
+}
+
 Vars
 extractVariables(const Expr *expr, const Rewriter &RW) {
+    llvm::TimeTraceScope TimeScope("extractVariables");
     Vars vars;
 
     if (const auto *declRef = llvm::dyn_cast<clang::DeclRefExpr>(expr)) {
@@ -158,6 +264,7 @@ extractVariables(const Expr *expr, const Rewriter &RW) {
 
 const Stmt *
 getParentIfLoop(const Expr *e, ASTContext &Context) {
+    llvm::TimeTraceScope TimeScope("getParentIfLoop");
     const Stmt *curr = e;
     const Stmt *parent = nullptr;
 
@@ -188,8 +295,7 @@ findCallExpr(const Stmt * s) {
     for (const Stmt *Child : s->children()) {
         if (Child) {
             if (const auto *FCall = llvm::dyn_cast<CallExpr>(Child)) {
-                const FunctionDecl *CalledFunc = FCall->getDirectCallee();
-                if (CalledFunc && CalledFunc->isDefined() && !CalledFunc->isInStdNamespace() && CalledFunc->getIdentifier()) {
+                if (getTaskCallee(FCall)) {
                     return FCall;
                 }
             }
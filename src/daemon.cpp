@@ -0,0 +1,247 @@
+#include <daemon.hpp>
+#include <devirtualization.hpp>
+#include <options.hpp>
+#include <output.hpp>
+#include <profiling.hpp>
+#include <visitors.hpp>
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+#include <clang/Serialization/PCHContainerOperations.h>
+#include <clang/Tooling/Tooling.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <chrono>
+#include <sstream>
+
+static bool
+getModificationTime(const std::string &file, llvm::sys::TimePoint<> &modified) {
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(file, status)) {
+        return false;
+    }
+
+    modified = status.getLastModificationTime();
+    return true;
+}
+
+static std::string
+getAbsolutePath(const std::string &file) {
+    llvm::SmallString<256> path(file);
+    llvm::sys::fs::make_absolute(path);
+    return std::string(path.str());
+}
+
+/* every file read by the parse, main file and headers, with its modification time */
+static std::map<std::string, llvm::sys::TimePoint<>>
+getDependencies(const ASTUnit &AST) {
+    const SourceManager &SM = AST.getSourceManager();
+    std::map<std::string, llvm::sys::TimePoint<>> dependencies;
+
+    for (unsigned i = 0, e = SM.local_sloc_entry_size(); i < e; ++i) {
+        const SrcMgr::SLocEntry &entry = SM.getLocalSLocEntry(i);
+        if (!entry.isFile()) continue;
+
+        auto file = entry.getFile().getContentCache().OrigEntry;
+        if (!file) continue;
+
+        std::string path = getAbsolutePath(file->getName().str());
+        llvm::sys::TimePoint<> modified;
+        if (getModificationTime(path, modified)) {
+            dependencies[path] = modified;
+        }
+    }
+
+    return dependencies;
+}
+
+/* the dependencies modified or removed since the parse */
+static std::vector<std::string>
+getChangedDependencies(const std::map<std::string, llvm::sys::TimePoint<>> &dependencies) {
+    std::vector<std::string> changed;
+
+    for (const auto &dependency : dependencies) {
+        llvm::sys::TimePoint<> modified;
+        if (!getModificationTime(dependency.first, modified) || modified != dependency.second) {
+            changed.push_back(dependency.first);
+        }
+    }
+
+    return changed;
+}
+
+
+/* PUBLICS */
+
+
+AutoparDaemon::AutoparDaemon(const tooling::CompilationDatabase &Compilations)
+    : Compilations(Compilations) {}
+
+int AutoparDaemon::run(const std::vector<std::string> &files, std::istream &in) {
+    for (const auto &file : files) {
+        if (load(getAbsolutePath(file), false)) {
+            llvm::outs() << "loaded " << file << "\n";
+        } else {
+            llvm::outs() << "error " << file << " could not be parsed\n";
+        }
+    }
+    llvm::outs().flush();
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream request(line);
+        std::string command;
+        request >> command;
+
+        if (command.empty()) continue;
+
+        if (command == "quit") {
+            break;
+        } else if (command == "transform" || command == "reload") {
+            std::string file;
+            bool hasFile = false;
+            while (request >> file) {
+                hasFile = true;
+                handleTransform(file, command == "reload");
+            }
+            if (!hasFile) {
+                llvm::outs() << "error " << command << " expects at least one file\n";
+            }
+        } else if (command == "status") {
+            for (const auto &unit : units) {
+                llvm::outs() << "loaded " << unit.first << (unit.second.rewriter ? " (transformed)" : "") << "\n";
+            }
+            llvm::outs() << "ok status " << units.size() << "\n";
+        } else {
+            llvm::outs() << "error unknown command: " << command << "\n";
+        }
+
+        llvm::outs().flush();
+    }
+
+    return 0;
+}
+
+
+/* PRIVATES */
+
+
+AutoparDaemon::Unit *AutoparDaemon::load(const std::string &file, bool forceParse) {
+    if (!llvm::sys::fs::exists(file)) {
+        return nullptr;
+    }
+
+    auto it = units.find(file);
+    std::vector<std::string> changed;
+    if (it != units.end() && it->second.AST) {
+        changed = getChangedDependencies(it->second.dependencies);
+    }
+
+    /*
+    only a change of the main file alone is reparsed in place: the file manager of the AST unit keeps
+    the entries of the headers it read, so a changed header is only seen by a fresh parse
+    */
+    bool mainOnly = changed.size() == 1 && changed.front() == file;
+
+    if (it == units.end() || forceParse || !it->second.AST || (!changed.empty() && !mainOnly)) {
+        Unit unit;
+        unit.AST = parse(file);
+        if (!unit.AST) {
+            units.erase(file);
+            return nullptr;
+        }
+        unit.dependencies = getDependencies(*unit.AST);
+        it = units.insert_or_assign(file, std::move(unit)).first;
+        return &it->second;
+    }
+
+    Unit &unit = it->second;
+    if (mainOnly) {
+        unit.rewriter.reset();
+        if (!reparse(unit, file)) {
+            units.erase(it);
+            return nullptr;
+        }
+        unit.dependencies = getDependencies(*unit.AST);
+    }
+
+    return &unit;
+}
+
+std::unique_ptr<ASTUnit> AutoparDaemon::parse(const std::string &file) {
+    tooling::ClangTool Tool(Compilations, {file});
+    std::vector<std::unique_ptr<ASTUnit>> ASTs;
+
+    Tool.buildASTs(ASTs);
+
+    if (ASTs.empty()) {
+        return nullptr;
+    }
+
+    return std::move(ASTs.front());
+}
+
+bool AutoparDaemon::reparse(Unit &unit, const std::string &file) {
+    /* remap the main file so the reparse never sees stale cached file contents */
+    auto buffer = llvm::MemoryBuffer::getFile(file);
+    if (!buffer) {
+        return false;
+    }
+
+    ASTUnit::RemappedFile remapped(file, buffer->release());
+
+    /* Reparse() returns true on error, the AST unit takes ownership of the buffer */
+    return !unit.AST->Reparse(std::make_shared<PCHContainerOperations>(), remapped);
+}
+
+void AutoparDaemon::transform(Unit &unit) {
+    ASTContext &AC = unit.AST->getASTContext();
+    auto R = std::make_unique<Rewriter>(unit.AST->getSourceManager(), unit.AST->getLangOpts());
+    TaskCreationStats stats;
+    TaskCreationVisitor Visitor(*R, AC, stats);
+
+    {
+        llvm::TimeTraceScope TimeScope("TaskCreation", unit.AST->getMainFileName());
+        llvm::TimeRegion Region(getPhaseTimer(Phase::TaskCreation));
+        analyzeTranslationUnit(AC);
+        Visitor.TraverseDecl(AC.getTranslationUnitDecl());
+    }
+
+    unit.rewriter = std::move(R);
+    printSummary(unit.AST->getMainFileName(), stats);
+}
+
+void AutoparDaemon::handleTransform(const std::string &file, bool forceParse) {
+    auto start = std::chrono::steady_clock::now();
+    std::string path = getAbsolutePath(file);
+
+    Unit *unit = load(path, forceParse);
+    if (!unit) {
+        llvm::outs() << "error " << file << " could not be parsed\n";
+        return;
+    }
+
+    bool cached = unit->rewriter != nullptr;
+    if (!cached) {
+        transform(*unit);
+    }
+
+    /* written like the one-shot driver does, --output-dir and --export-replacements included */
+    bool written;
+    {
+        llvm::TimeTraceScope TimeScope("Output", unit->AST->getMainFileName());
+        llvm::TimeRegion Region(getPhaseTimer(Phase::Output));
+        written = writeOutput(*unit->rewriter);
+    }
+
+    std::string outputPath = ExportReplacementsDir.empty() ? getOutputPath(path) : ExportReplacementsDir.getValue();
+    if (!written) {
+        llvm::outs() << "error " << file << " cannot write " << outputPath << "\n";
+        return;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    llvm::outs() << "ok " << file << " " << outputPath << (cached ? " cached " : " ") << elapsed.count() / 1000.0 << "ms\n";
+}
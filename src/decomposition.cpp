@@ -0,0 +1,189 @@
+#include <decomposition.hpp>
+
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/ExprCXX.h>
+#include <llvm-18/llvm/Support/Casting.h>
+#include <algorithm>
+#include <set>
+
+/* the value is moved out of an AUTOPAR_Slot declared at the start of the function */
+bool
+isHoistableType(QualType type) {
+    if (type.isNull() || type->isVoidType() || type->isReferenceType() || type->isDependentType() || type->isIncompleteType()) {
+        return false;
+    }
+
+    if (const CXXRecordDecl *record = type->getAsCXXRecordDecl()) {
+        if (record->isLambda() || !record->getIdentifier() || record->getParentFunctionOrMethod()) return false;
+    }
+
+    return true;
+}
+
+/* children of `parent` that are not always evaluated, or that name the object an operator writes */
+static bool
+isHoistableChild(const Stmt *parent, const Stmt *child) {
+    if (const auto *binary = llvm::dyn_cast<BinaryOperator>(parent)) {
+        if (binary->isLogicalOp() || binary->isCommaOp()) return child == binary->getLHS();
+        if (binary->isAssignmentOp()) return child == binary->getRHS();
+    }
+    if (const auto *unary = llvm::dyn_cast<UnaryOperator>(parent)) {
+        return !unary->isIncrementDecrementOp() && unary->getOpcode() != UO_AddrOf;
+    }
+    if (const auto *conditional = llvm::dyn_cast<ConditionalOperator>(parent)) {
+        return child == conditional->getCond();
+    }
+    return !llvm::isa<BinaryConditionalOperator>(parent) && !llvm::isa<ArraySubscriptExpr>(parent);
+}
+
+/*
+walks `s` in evaluation order, `inputs` receives the hoisted calls whose value `s` uses. A call can't be
+hoisted when it starts where the hoisted call containing it starts, since both would be rewritten at the
+same location. Fails when a call of a user function has to stay in the statement
+*/
+static bool
+collectCalls(const Stmt *s, bool hoistable, SourceLocation enclosing, Decomposition &d, std::vector<int> &inputs) {
+    if (llvm::isa<LambdaExpr>(s) || llvm::isa<CXXDefaultArgExpr>(s) || llvm::isa<CXXDefaultInitExpr>(s)) return true;
+    if (llvm::isa<StmtExpr>(s)) return !checkTaskCreation(s);
+
+    const auto *call = llvm::dyn_cast<CallExpr>(s);
+    bool task = call && call != d.root && getTaskCallee(call);
+    bool hoist = task && hoistable && !call->isGLValue() && isHoistableType(call->getType())
+        && call->getBeginLoc() != enclosing && !call->getBeginLoc().isMacroID();
+
+    if (task && !hoist) return false;
+
+    std::vector<int> args;
+    for (const Stmt *child : s->children()) {
+        if (!child) continue;
+        if (!collectCalls(child, hoistable && isHoistableChild(s, child), hoist ? call->getBeginLoc() : enclosing, d, hoist ? args : inputs)) {
+            return false;
+        }
+    }
+
+    if (hoist) {
+        inputs.push_back(d.calls.size());
+        d.calls.push_back(call);
+        d.inputs.push_back(args);
+    }
+
+    return true;
+}
+
+/* worth it when two calls can run at the same time, or when the call left in the statement waits for one */
+bool
+decomposeExpr(const Expr *root, const CallExpr *rootCall, Decomposition &d) {
+    d.root = rootCall;
+
+    if (!collectCalls(root, true, SourceLocation(), d, d.finalInputs)) return false;
+
+    return d.calls.size() >= 2 || (d.root && !d.calls.empty());
+}
+
+static void
+addVars(std::set<std::string> &to, const std::set<std::string> &vars) {
+    to.insert(vars.begin(), vars.end());
+}
+
+/* variables used as values are read, the other uses may write them */
+static void
+collectDependencies(const Stmt *s, bool value, const Decomposition &d, const Rewriter &RW, DependInfo &depInfo) {
+    const auto *call = llvm::dyn_cast<CallExpr>(s);
+    if (call && std::find(d.calls.begin(), d.calls.end(), call) != d.calls.end()) return;
+    if (llvm::isa<CXXDefaultArgExpr>(s) || llvm::isa<CXXDefaultInitExpr>(s)) return;
+
+    if (call && call == d.root) {
+        DependInfo callInfo = getFCallDependencies(getTaskCallee(call), call, RW);
+        addVars(depInfo.read, callInfo.read);
+        addVars(depInfo.write, callInfo.write);
+        depInfo.guard = callInfo.guard;
+        depInfo.instanceGuard = callInfo.instanceGuard;
+        depInfo.affinity = callInfo.affinity;
+        return;
+    }
+
+    const Expr *written = nullptr;
+    if (const auto *binary = llvm::dyn_cast<BinaryOperator>(s)) {
+        if (binary->isAssignmentOp()) written = binary->getLHS();
+    } else if (const auto *unary = llvm::dyn_cast<UnaryOperator>(s)) {
+        if (unary->isIncrementDecrementOp()) written = unary->getSubExpr();
+    }
+
+    if (written || llvm::isa<ArraySubscriptExpr>(s)) {
+        const Expr *object = written ? written : llvm::cast<Expr>(s);
+        Vars vars = extractVariables(object->IgnoreParenImpCasts(), RW);
+        addVars(written ? depInfo.write : depInfo.read, vars.vars);
+        addVars(depInfo.read, vars.idxs);
+
+        if (written) {
+            for (const Stmt *child : s->children()) {
+                if (child && child != written) collectDependencies(child, false, d, RW, depInfo);
+            }
+        }
+        return;
+    }
+
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) {
+        if (llvm::isa<VarDecl>(ref->getDecl())) {
+            (value ? depInfo.read : depInfo.write).insert(ref->getNameInfo().getAsString());
+        }
+        return;
+    }
+
+    if (const auto *cast = llvm::dyn_cast<ImplicitCastExpr>(s)) {
+        collectDependencies(cast->getSubExpr(), cast->getCastKind() == CK_LValueToRValue, d, RW, depInfo);
+        return;
+    }
+
+    if (const auto *member = llvm::dyn_cast<MemberExpr>(s)) {
+        collectDependencies(member->getBase(), value && !member->isArrow(), d, RW, depInfo);
+        return;
+    }
+
+    if (const auto *paren = llvm::dyn_cast<ParenExpr>(s)) {
+        collectDependencies(paren->getSubExpr(), value, d, RW, depInfo);
+        return;
+    }
+
+    for (const Stmt *child : s->children()) {
+        if (child) collectDependencies(child, false, d, RW, depInfo);
+    }
+}
+
+/* dependencies of the statement once its hoisted calls are replaced by their temporaries */
+DependInfo
+getStatementDependencies(const Expr *root, const Decomposition &d, const Rewriter &RW) {
+    DependInfo depInfo;
+    collectDependencies(root, false, d, RW, depInfo);
+    removeFunctionNames(depInfo, root);
+
+    /* a variable both read and written is only listed as written */
+    for (const auto &var : depInfo.write) {
+        depInfo.read.erase(var);
+    }
+
+    return depInfo;
+}
+
+static void
+collectFunctionNames(const Stmt *s, std::set<std::string> &names) {
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) {
+        if (llvm::isa<FunctionDecl>(ref->getDecl())) names.insert(ref->getNameInfo().getAsString());
+    }
+
+    for (const Stmt *child : s->children()) {
+        if (child) collectFunctionNames(child, names);
+    }
+}
+
+/* the arguments of a call made of other calls name functions, which are no dependencies */
+void
+removeFunctionNames(DependInfo &depInfo, const Stmt *s) {
+    std::set<std::string> names;
+    collectFunctionNames(s, names);
+
+    for (const auto &name : names) {
+        depInfo.read.erase(name);
+        depInfo.write.erase(name);
+    }
+}
@@ -0,0 +1,345 @@
+#include <devirtualization.hpp>
+#include <summaries.hpp>
+#include <templates.hpp>
+
+#include <clang/AST/ExprCXX.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <llvm/Support/Casting.h>
+#include <algorithm>
+
+class HierarchyCollector : public RecursiveASTVisitor<HierarchyCollector> {
+public:
+    bool shouldVisitTemplateInstantiations() const { return true; }
+
+    bool VisitCXXRecordDecl(CXXRecordDecl *RD) {
+        if (RD->isThisDeclarationADefinition() && !RD->isDependentType()) {
+            records.push_back(RD);
+        }
+        return true;
+    }
+
+    bool VisitCXXMethodDecl(CXXMethodDecl *MD) {
+        if (MD->isVirtual() && MD->isCanonicalDecl()) {
+            methods.push_back(MD);
+        }
+        return true;
+    }
+
+    std::vector<const CXXRecordDecl *> records;
+    std::vector<const CXXMethodDecl *> methods;
+};
+
+/* unwraps conversions and temporaries until a lambda or a reference to a function remains */
+static const Expr *
+stripToCallable(const Expr *e) {
+    while (e) {
+        e = e->IgnoreImplicit()->IgnoreParens();
+
+        if (llvm::isa<LambdaExpr>(e) || llvm::isa<DeclRefExpr>(e)) {
+            return e;
+        }
+
+        if (const auto *unary = llvm::dyn_cast<UnaryOperator>(e)) {
+            if (unary->getOpcode() != UO_AddrOf && unary->getOpcode() != UO_Deref) return nullptr;
+            e = unary->getSubExpr();
+        } else if (const auto *construct = llvm::dyn_cast<CXXConstructExpr>(e)) {
+            if (construct->getNumArgs() != 1) return nullptr;
+            e = construct->getArg(0);
+        } else if (const auto *cast = llvm::dyn_cast<ExplicitCastExpr>(e)) {
+            e = cast->getSubExpr();
+        } else {
+            return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+/* the initializer of a variable that can never be rebound to another callable */
+static const Expr *
+getFixedInitializer(const Expr *e) {
+    const auto *ref = llvm::dyn_cast<DeclRefExpr>(e->IgnoreParenImpCasts());
+    const auto *VD = ref ? llvm::dyn_cast<VarDecl>(ref->getDecl()) : nullptr;
+
+    if (!VD || !VD->hasInit()) return nullptr;
+
+    QualType type = VD->getType();
+    if (type.isConstQualified() || VD->isConstexpr() || type->isReferenceType()
+        || (type->getAsCXXRecordDecl() && type->getAsCXXRecordDecl()->isLambda())) {
+        return VD->getInit();
+    }
+
+    return nullptr;
+}
+
+static bool
+isStdFunction(const CXXRecordDecl *RD) {
+    return RD && RD->isInStdNamespace() && RD->getIdentifier() && RD->getName() == "function";
+}
+
+static void
+resolveLambda(CallTarget &target, const LambdaExpr *lambda) {
+    for (const LambdaCapture &capture : lambda->captures()) {
+        if (capture.capturesThis() || capture.capturesVLAType()) {
+            return; /* member writes cannot be expressed in a depend clause */
+        }
+
+        const auto *VD = llvm::dyn_cast_or_null<VarDecl>(capture.getCapturedVar());
+        if (!VD) return;
+
+        QualType type = VD->getType();
+        if (capture.getCaptureKind() == LCK_ByRef
+            || (type->isPointerType() && !type->getPointeeType().isConstQualified())) {
+            target.captures.push_back(VD);
+        }
+    }
+
+    target.callee = lambda->getCallOperator();
+}
+
+/*
+dependent calls of a template pattern are resolved in every instantiation, the pattern is then
+rewritten once with the merged result
+*/
+static CallTarget
+resolveTemplateCall(const CallExpr *FCall) {
+    CallTarget merged;
+    const std::vector<InstantiatedCall> *instances = InstantiationIndex::get().lookup(FCall);
+
+    if (!instances) return merged;
+
+    std::vector<const FunctionDecl *> tasks;
+    std::vector<const FunctionDecl *> serial;
+
+    for (const InstantiatedCall &instance : *instances) {
+        CallTarget target = resolveCallTarget(instance.call);
+
+        if (!target.callee) {
+            serial.push_back(instance.function);
+            continue;
+        }
+
+        tasks.push_back(instance.function);
+        merged.instances.push_back(instance.call);
+
+        if (!merged.callee) {
+            merged.callee = target.callee;
+            merged.object = target.object;
+            merged.argOffset = target.argOffset;
+        }
+
+        /* a dynamic type of another instantiation can never match this one's object */
+        merged.guarded = merged.guarded || target.guarded;
+        for (const CXXRecordDecl *RD : target.dynamicTypes) {
+            if (std::find(merged.dynamicTypes.begin(), merged.dynamicTypes.end(), RD) == merged.dynamicTypes.end()) {
+                merged.dynamicTypes.push_back(RD);
+            }
+        }
+    }
+
+    if (tasks.empty()) return CallTarget();
+
+    if (!serial.empty()) {
+        merged.instanceGuard = getInstantiationGuard(tasks, serial);
+        if (merged.instanceGuard.empty()) return CallTarget();
+    }
+
+    return merged;
+}
+
+
+/* PUBLICS */
+
+
+ClassHierarchy &ClassHierarchy::get() {
+    static ClassHierarchy hierarchy;
+    return hierarchy;
+}
+
+void ClassHierarchy::build(ASTContext &AC) {
+    overriders.clear();
+    records.clear();
+
+    HierarchyCollector collector;
+    collector.TraverseDecl(AC.getTranslationUnitDecl());
+
+    records = std::move(collector.records);
+    for (const CXXMethodDecl *MD : collector.methods) {
+        addOverrider(MD, MD);
+    }
+}
+
+/* `overrider` is a target of the calls of `base` and of every method `base` overrides, transitively */
+void ClassHierarchy::addOverrider(const CXXMethodDecl *base, const CXXMethodDecl *overrider) {
+    std::vector<const CXXMethodDecl *> &targets = overriders[base->getCanonicalDecl()];
+    if (std::find(targets.begin(), targets.end(), overrider) != targets.end()) return;
+
+    targets.push_back(overrider);
+    for (const CXXMethodDecl *overridden : base->overridden_methods()) {
+        addOverrider(overridden, overrider);
+    }
+}
+
+std::vector<const CXXMethodDecl *> ClassHierarchy::getOverriders(const CXXMethodDecl *MD) const {
+    auto it = overriders.find(MD->getCanonicalDecl());
+    if (it == overriders.end()) {
+        return {MD->getCanonicalDecl()};
+    }
+    return it->second;
+}
+
+std::vector<const CXXRecordDecl *> ClassHierarchy::getConcreteSubclasses(const CXXRecordDecl *base) const {
+    std::vector<const CXXRecordDecl *> subclasses;
+
+    for (const CXXRecordDecl *RD : records) {
+        if (RD->isAbstract()) continue;
+        if (RD->getCanonicalDecl() == base->getCanonicalDecl() || RD->isDerivedFrom(base)) {
+            subclasses.push_back(RD);
+        }
+    }
+
+    return subclasses;
+}
+
+void
+analyzeTranslationUnit(ASTContext &AC) {
+    ClassHierarchy::get().build(AC);
+    InstantiationIndex::get().build(AC);
+}
+
+bool
+isTaskFunction(const FunctionDecl *FD) {
+    if (!FD || FD->isInStdNamespace()) return false;
+
+    if (const auto *method = llvm::dyn_cast<CXXMethodDecl>(FD)) {
+        if (method->getParent()->isLambda()) return FD->isDefined();
+    }
+
+    if (!FD->getIdentifier()) return false;
+
+    return FD->isDefined() || SummaryIndex::get().lookup(FD);
+}
+
+CallTarget
+resolveCallTarget(const CallExpr *FCall) {
+    CallTarget target;
+
+    if (FCall->isInstantiationDependent()) {
+        return resolveTemplateCall(FCall);
+    }
+
+    if (const auto *memberCall = llvm::dyn_cast<CXXMemberCallExpr>(FCall)) {
+        const CXXMethodDecl *method = memberCall->getMethodDecl();
+        if (!method) return target;
+
+        target.object = memberCall->getImplicitObjectArgument();
+
+        if (!method->isVirtual()) {
+            if (isTaskFunction(method)) target.callee = method;
+            return target;
+        }
+
+        /* final classes and methods, or a statically known dynamic type */
+        if (const CXXMethodDecl *devirtualized = method->getDevirtualizedMethod(target.object, false)) {
+            if (isTaskFunction(devirtualized)) target.callee = devirtualized;
+            return target;
+        }
+
+        for (const CXXMethodDecl *overrider : ClassHierarchy::get().getOverriders(method)) {
+            const FunctionDecl *definition = nullptr;
+            if (overrider->isDefined(definition)) {
+                target.targets.push_back(definition);
+            } else if (!overrider->isPureVirtual()) {
+                if (!SummaryIndex::get().lookup(overrider)) return target;
+                target.targets.push_back(overrider);
+            }
+        }
+
+        if (target.targets.empty() || std::any_of(target.targets.begin(), target.targets.end(),
+                                                  [](const FunctionDecl *FD) { return FD->isInStdNamespace(); })) {
+            target.targets.clear();
+            return target;
+        }
+
+        /* overriders in other TUs are unknown, so the task is only deferred for the analyzed dynamic types */
+        target.dynamicTypes = ClassHierarchy::get().getConcreteSubclasses(method->getParent());
+        if (target.dynamicTypes.empty()) {
+            target.targets.clear();
+            return target;
+        }
+
+        target.callee = method;
+        target.guarded = true;
+        return target;
+    }
+
+    if (const auto *operatorCall = llvm::dyn_cast<CXXOperatorCallExpr>(FCall)) {
+        const auto *method = llvm::dyn_cast_or_null<CXXMethodDecl>(FCall->getDirectCallee());
+
+        if (operatorCall->getOperator() != OO_Call || !method || FCall->getNumArgs() == 0) {
+            return target;
+        }
+
+        const Expr *object = FCall->getArg(0);
+        const Expr *callable = nullptr;
+
+        if (const auto *lambda = llvm::dyn_cast<LambdaExpr>(object->IgnoreImplicit()->IgnoreParens())) {
+            callable = lambda;
+        } else if (method->getParent()->isLambda() || isStdFunction(method->getParent())) {
+            if (const Expr *init = getFixedInitializer(object)) {
+                callable = stripToCallable(init);
+            }
+        }
+
+        target.argOffset = 1;
+
+        if (const auto *lambda = llvm::dyn_cast_or_null<LambdaExpr>(callable)) {
+            resolveLambda(target, lambda);
+        } else if (const auto *ref = llvm::dyn_cast_or_null<DeclRefExpr>(callable)) {
+            const auto *FD = llvm::dyn_cast<FunctionDecl>(ref->getDecl());
+            if (isTaskFunction(FD)) target.callee = FD;
+        }
+
+        return target;
+    }
+
+    if (const FunctionDecl *FD = FCall->getDirectCallee()) {
+        if (isTaskFunction(FD)) target.callee = FD;
+        return target;
+    }
+
+    /* calls through function pointers and references bound once */
+    if (const Expr *init = getFixedInitializer(FCall->getCallee()->IgnoreParenImpCasts())) {
+        if (const auto *ref = llvm::dyn_cast_or_null<DeclRefExpr>(stripToCallable(init))) {
+            const auto *FD = llvm::dyn_cast<FunctionDecl>(ref->getDecl());
+            if (isTaskFunction(FD)) target.callee = FD;
+        }
+    }
+
+    return target;
+}
+
+std::string
+getTypeGuard(const CallTarget &target, const Rewriter &RW) {
+    if (!target.guarded || !target.object) return "";
+
+    std::string object = llvm::isa<CXXThisExpr>(target.object->IgnoreParenImpCasts())
+                             ? "this"
+                             : RW.getRewrittenText(target.object->getSourceRange());
+    if (object.empty()) return "";
+
+    if (target.object->getType()->isPointerType()) {
+        object = "*(" + object + ")";
+    }
+
+    std::string guard;
+    for (const CXXRecordDecl *RD : target.dynamicTypes) {
+        const ASTContext &AC = RD->getASTContext();
+        std::string typeName = AC.getRecordType(RD).getAsString(AC.getPrintingPolicy());
+
+        guard += guard.empty() ? "(" : " || ";
+        guard += "typeid(" + object + ") == typeid(" + typeName + ")";
+    }
+
+    return guard + ")";
+}
@@ -0,0 +1,109 @@
+#include <instrumentation.hpp>
+
+/*
+instrumentation code pasted into every instrumented output file: its site table and the probes, which
+are scoped objects around task bodies, taskwaits and taskgroups. The counters and trace buffers they
+record into are in autopar_rt, shared by every output file of the program
+*/
+static const std::string AUTOPAR_INSTRUMENTATION_CODE = R"(static const AUTOPAR_Site *AUTOPAR_GetSites(int &count);
+
+/* the probes differ between instrumentation modes, so every output file keeps its own copy */
+namespace {
+
+/* sites are numbered per output file, the runtime numbers them in the whole program */
+static int AUTOPAR_SiteBase() {
+    static const int base = [] {
+        int count;
+        const AUTOPAR_Site *sites = AUTOPAR_GetSites(count);
+        return AUTOPAR_RegisterSites(sites, count);
+    }();
+    return base;
+}
+
+static inline void AUTOPAR_SpawnProbe(int site, bool created) {
+#if AUTOPAR_INSTRUMENT_STATS
+    AUTOPAR_CountSpawn(AUTOPAR_SiteBase() + site, created);
+#endif
+}
+
+/* `site` is already numbered in the whole program */
+static inline void AUTOPAR_EndProbe(int site, unsigned long long start, bool wait, int depth) {
+    unsigned long long end = AUTOPAR_Ticks();
+#if AUTOPAR_INSTRUMENT_STATS
+    AUTOPAR_CountProbe(site, start, end, wait, depth);
+#endif
+#if AUTOPAR_INSTRUMENT_TRACE
+#ifdef AUTOPAR_WS_HPP
+    AUTOPAR_TraceProbe(site, start, end, autopar_ws::workerId);
+#else
+    AUTOPAR_TraceProbe(site, start, end, omp_get_thread_num());
+#endif
+#endif
+}
+
+/* task bodies, with the depth of the task that spawned them, and taskgroups */
+struct AUTOPAR_TaskProbe {
+    int site;
+    int depth;
+    unsigned long long start;
+
+    AUTOPAR_TaskProbe(int site, int depth = 0) : site(AUTOPAR_SiteBase() + site), depth(depth), start(AUTOPAR_Ticks()) {}
+    ~AUTOPAR_TaskProbe() { AUTOPAR_EndProbe(site, start, false, depth); }
+};
+
+struct AUTOPAR_WaitProbe {
+    int site;
+    unsigned long long start;
+
+    AUTOPAR_WaitProbe(int site) : site(AUTOPAR_SiteBase() + site), start(AUTOPAR_Ticks()) {}
+    ~AUTOPAR_WaitProbe() { AUTOPAR_EndProbe(site, start, true, 0); }
+};
+
+}
+)";
+
+static std::string
+escape(const std::string &str) {
+    std::string escaped;
+
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+
+    return escaped;
+}
+
+
+/* PUBLICS */
+
+
+std::string
+getInstrumentationRuntime(bool stats, bool trace) {
+    return "#define AUTOPAR_INSTRUMENT_STATS " + std::to_string(stats) + "\n"
+        + "#define AUTOPAR_INSTRUMENT_TRACE " + std::to_string(trace) + "\n"
+        + AUTOPAR_INSTRUMENTATION_CODE;
+}
+
+/* definition of the sites declared by the runtime, appended to the end of the output */
+std::string
+getSiteTable(const std::vector<ProbeSite> &sites) {
+    std::string table = "\n\nstatic const AUTOPAR_Site *AUTOPAR_GetSites(int &count) {\n";
+
+    if (sites.empty()) {
+        return table + "    count = 0;\n    return nullptr;\n}\n";
+    }
+
+    table += "    static const AUTOPAR_Site sites[] = {\n";
+    for (const ProbeSite &site : sites) {
+        table += "        {\"" + site.kind + "\", \"" + escape(site.callee) + "\", \"" + escape(site.file) + "\", "
+            + std::to_string(site.line) + ", " + std::to_string(site.column) + "},\n";
+    }
+    table += "    };\n";
+    table += "    count = " + std::to_string(sites.size()) + ";\n";
+    table += "    return sites;\n}\n";
+
+    return table;
+}
@@ -0,0 +1,29 @@
+#include <library.hpp>
+#include <options.hpp>
+
+#include <clang/AST/DeclCXX.h>
+#include <llvm-18/llvm/Support/Casting.h>
+#include <algorithm>
+
+/*
+the functions given by --entry-points, or with --library the functions a user of the library can call:
+external linkage, default visibility and public access. `main` starts its team unconditionally
+*/
+bool
+isEntryPoint(const FunctionDecl *f) {
+    if (f->isMain()) return false;
+
+    if (!EntryPoints.empty()) {
+        std::string name = f->getNameAsString();
+        std::string qualifiedName = f->getQualifiedNameAsString();
+        return std::any_of(EntryPoints.begin(), EntryPoints.end(), [&](const std::string &entry) {
+            return entry == name || entry == qualifiedName;
+        });
+    }
+
+    if (!Library) return false;
+    if (!f->isExternallyVisible() || f->getVisibility() != DefaultVisibility) return false;
+
+    const auto *method = llvm::dyn_cast<CXXMethodDecl>(f);
+    return !method || method->getAccess() == AS_public;
+}
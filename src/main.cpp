@@ -1,5 +1,10 @@
 #include <consumers.hpp>
+#include <daemon.hpp>
 #include <frontend_actions.hpp>
+#include <options.hpp>
+#include <profiling.hpp>
+#include <summaries.hpp>
+#include <task_profile.hpp>
 
 #include <llvm-18/llvm/Support/CommandLine.h>
 
@@ -11,27 +16,57 @@
 #include <clang/Rewrite/Core/Rewriter.h>
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Tooling.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/raw_ostream.h>
+#include <iostream>
 
 using namespace clang;
 
+static llvm::cl::extrahelp CommonHelp(tooling::CommonOptionsParser::HelpMessage);
+
 int
 main(int argc, const char *argv[]) {
-    if (argc != 2) {
-        llvm::errs() << "Usage: autopar <filename>\n";
-        return 1;
-    }
-
-    auto ExpectedParser = tooling::CommonOptionsParser::create(argc, argv, llvm::cl::getGeneralCategory());
+    auto ExpectedParser = tooling::CommonOptionsParser::create(argc, argv, AutoparCategory);
     if (!ExpectedParser) {
         llvm::errs() << ExpectedParser.takeError();
         return 1;
     }
 
     tooling::CommonOptionsParser &OptionsParser = ExpectedParser.get();
-    tooling::ClangTool Tool(OptionsParser.getCompilations(), OptionsParser.getSourcePathList());
+    int result;
 
-    return Tool.run(tooling::newFrontendActionFactory<TaskCreationFrontendAction>().get());
-}
+    if (!SummariesFile.empty() && !SummaryIndex::get().load(SummariesFile)) {
+        return 1;
+    }
 
+    if (!ProfileFile.empty() && !TaskProfile::get().load(ProfileFile)) {
+        return 1;
+    }
+
+    startProfiling(argv[0]);
+
+    if (!CollectSummariesFile.empty()) {
+        /* merge into an existing index so that sharded runs can share one file */
+        if (llvm::sys::fs::exists(CollectSummariesFile) && !SummaryIndex::get().load(CollectSummariesFile)) {
+            return 1;
+        }
+
+        tooling::ClangTool Tool(OptionsParser.getCompilations(), OptionsParser.getSourcePathList());
+        result = Tool.run(tooling::newFrontendActionFactory<SummaryFrontendAction>().get());
+
+        if (!SummaryIndex::get().save(CollectSummariesFile)) {
+            result = 1;
+        }
+    } else if (DaemonMode) {
+        AutoparDaemon Daemon(OptionsParser.getCompilations());
+        result = Daemon.run(OptionsParser.getSourcePathList(), std::cin);
+    } else {
+        tooling::ClangTool Tool(OptionsParser.getCompilations(), OptionsParser.getSourcePathList());
+        result = Tool.run(tooling::newFrontendActionFactory<TaskCreationFrontendAction>().get());
+    }
+
+    finishProfiling();
+
+    return result;
+}
@@ -0,0 +1,187 @@
+#include <numa.hpp>
+#include <concepts.hpp>
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/DeclTemplate.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/AST/ParentMapContext.h>
+#include <llvm-18/llvm/Support/Casting.h>
+
+static bool
+isDeclRefTo(const Expr *e, const VarDecl *var) {
+    const auto *ref = llvm::dyn_cast<DeclRefExpr>(e->IgnoreParenImpCasts());
+    return ref && ref->getDecl() == var;
+}
+
+/* whether `s` assigns an element of `var` */
+static bool
+writesElements(const Stmt *s, const VarDecl *var) {
+    if (!s) return false;
+
+    const Expr *lhs = nullptr;
+    if (const auto *op = llvm::dyn_cast<BinaryOperator>(s)) {
+        if (op->isAssignmentOp()) lhs = op->getLHS();
+    } else if (const auto *op = llvm::dyn_cast<CXXOperatorCallExpr>(s)) {
+        if (op->isAssignmentOp() && op->getNumArgs() > 0) lhs = op->getArg(0);
+    }
+
+    if (lhs) {
+        lhs = lhs->IgnoreParenImpCasts();
+        if (const auto *subscript = llvm::dyn_cast<ArraySubscriptExpr>(lhs)) {
+            if (isDeclRefTo(subscript->getBase(), var)) return true;
+        } else if (const auto *subscript = llvm::dyn_cast<CXXOperatorCallExpr>(lhs)) {
+            if (subscript->getOperator() == OO_Subscript && isDeclRefTo(subscript->getArg(0), var)) return true;
+        }
+    }
+
+    for (const Stmt *Child : s->children()) {
+        if (writesElements(Child, var)) return true;
+    }
+
+    return false;
+}
+
+static bool
+references(const Stmt *s, const VarDecl *var) {
+    if (!s) return false;
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) return ref->getDecl() == var;
+
+    for (const Stmt *Child : s->children()) {
+        if (references(Child, var)) return true;
+    }
+
+    return false;
+}
+
+/*
+a vector with another allocator is another type, so it may only be used through its members
+and subscripts, never passed along or copied as a std::vector<T>
+*/
+static bool
+onlyUsedThroughMembers(const Stmt *s, const Stmt *parent, const VarDecl *var) {
+    if (!s) return true;
+
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) {
+        if (ref->getDecl() != var) return true;
+        if (parent && llvm::isa<MemberExpr>(parent)) return true;
+        if (const auto *op = llvm::dyn_cast_or_null<CXXOperatorCallExpr>(parent)) {
+            return op->getOperator() == OO_Subscript && op->getArg(0) == ref;
+        }
+        return false;
+    }
+
+    for (const Stmt *Child : s->children()) {
+        if (!onlyUsedThroughMembers(Child, s, var)) return false;
+    }
+
+    return true;
+}
+
+/* the first loop of the enclosing block using `var` after its declaration must initialize it */
+static bool
+isInitializedByLoop(const DeclStmt *DeclStat, const VarDecl *var, ASTContext &AC) {
+    auto parents = AC.getParentMapContext().getParents(*DeclStat);
+    if (parents.empty()) return false;
+
+    const auto *block = parents[0].get<CompoundStmt>();
+    if (!block) return false;
+
+    bool after = false;
+    for (const Stmt *s : block->body()) {
+        if (s == DeclStat) {
+            after = true;
+        } else if (after && llvm::isa<ForStmt>(s) && references(s, var)) {
+            return writesElements(llvm::cast<ForStmt>(s)->getBody(), var);
+        }
+    }
+
+    return false;
+}
+
+static bool
+isKnownSmall(const Expr *count, QualType element, ASTContext &AC) {
+    Expr::EvalResult result;
+    if (!count->EvaluateAsInt(result, AC)) return false;
+
+    unsigned long long elementSize = element.isNull() ? 1 : AC.getTypeSizeInChars(element).getQuantity();
+    return result.Val.getInt().getZExtValue() * elementSize < NUMA_MIN_BYTES;
+}
+
+FirstTouchSite
+findFirstTouchSite(const DeclStmt *DeclStat, ASTContext &AC, const Rewriter &RW) {
+    FirstTouchSite site;
+    if (!DeclStat->isSingleDecl()) return site;
+
+    const auto *var = llvm::dyn_cast<VarDecl>(DeclStat->getSingleDecl());
+    if (!var || !var->hasLocalStorage() || !var->hasInit() || var->getType()->getContainedAutoType()) return site;
+
+    const Expr *init = var->getInit()->IgnoreImplicit();
+    QualType element;
+
+    if (const auto *construct = llvm::dyn_cast<CXXConstructExpr>(init)) {
+        /* vector(count) and vector(count, value) */
+        if (!isStdVector(var->getType(), element) || construct->getNumArgs() == 0) return site;
+
+        const CXXConstructorDecl *ctor = construct->getConstructor();
+        if (ctor->getNumParams() == 0 || !ctor->getParamDecl(0)->getType()->isIntegerType()) return site;
+        if (element->isDependentType() || element->isIncompleteType() || isKnownSmall(construct->getArg(0), element, AC)) return site;
+
+        const auto *function = llvm::dyn_cast_or_null<FunctionDecl>(var->getParentFunctionOrMethod());
+        if (!function || !onlyUsedThroughMembers(function->getBody(), nullptr, var)) return site;
+
+        site.kind = FirstTouchSite::Vector;
+    } else if (const auto *alloc = llvm::dyn_cast<CXXNewExpr>(init)) {
+        /* new T[count] of trivial types leaves the memory untouched */
+        element = alloc->getAllocatedType();
+        std::optional<const Expr *> count = alloc->getArraySize();
+        if (!alloc->isArray() || alloc->hasInitializer() || !count || !*count) return site;
+        if (element->isDependentType() || !element.isTrivialType(AC) || isKnownSmall(*count, element, AC)) return site;
+
+        site.kind = FirstTouchSite::Raw;
+        site.bytes = "(" + RW.getRewrittenText((*count)->getSourceRange()) + ") * sizeof("
+            + element.getAsString(AC.getPrintingPolicy()) + ")";
+    } else if (const auto *call = llvm::dyn_cast<CallExpr>(init->IgnoreParenCasts())) {
+        const FunctionDecl *callee = call->getDirectCallee();
+        if (!callee || callee->getName() != "malloc" || call->getNumArgs() != 1) return site;
+        if (isKnownSmall(call->getArg(0), QualType(), AC)) return site;
+
+        site.kind = FirstTouchSite::Raw;
+        site.bytes = RW.getRewrittenText(call->getArg(0)->getSourceRange());
+    } else {
+        return site;
+    }
+
+    if (!isInitializedByLoop(DeclStat, var, AC)) {
+        site.kind = FirstTouchSite::None;
+        return site;
+    }
+
+    site.var = var;
+    site.element = element;
+
+    return site;
+}
+
+/*
+the data a task mostly works on: the first pointer argument the callee writes through, or else
+the first one it reads through. Tasks are spawned near the first element it points to
+*/
+std::string
+getAffinityLocator(const FunctionDecl *FDecl, const CallExpr *FCall, unsigned argOffset, const Rewriter &RW) {
+    const Expr *locator = nullptr;
+
+    for (unsigned i = 0; i < FDecl->getNumParams() && i + argOffset < FCall->getNumArgs(); ++i) {
+        QualType type = FDecl->getParamDecl(i)->getType();
+        if (!type->isPointerType() || type->isFunctionPointerType() || type->isVoidPointerType()) continue;
+
+        const Expr *arg = FCall->getArg(i + argOffset);
+        if (!type->getPointeeType().isConstQualified()) {
+            locator = arg;
+            break;
+        }
+        if (!locator) locator = arg;
+    }
+
+    if (!locator) return "";
+
+    return "(" + RW.getRewrittenText(locator->getSourceRange()) + ")[0]";
+}
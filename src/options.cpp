@@ -0,0 +1,151 @@
+#include <options.hpp>
+
+llvm::cl::OptionCategory AutoparCategory("autopar options");
+
+llvm::cl::opt<bool> DaemonMode(
+    "daemon",
+    llvm::cl::desc("Keep the parsed files in memory and serve transform requests read from stdin"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<std::string> ExportReplacementsDir(
+    "export-replacements",
+    llvm::cl::desc("Write the edits of each translation unit as clang-apply-replacements YAML into <dir> instead of output.cpp"),
+    llvm::cl::value_desc("dir"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> TimeTrace(
+    "time-trace",
+    llvm::cl::desc("Profile autopar itself: write a -ftime-trace compatible JSON and print a summary per file"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<std::string> TimeTraceFile(
+    "time-trace-file",
+    llvm::cl::desc("Output file of --time-trace"),
+    llvm::cl::value_desc("filename"),
+    llvm::cl::init("autopar-time-trace.json"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<unsigned> TimeTraceGranularity(
+    "time-trace-granularity",
+    llvm::cl::desc("Minimum duration in microseconds of the events recorded by --time-trace"),
+    llvm::cl::init(500),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<std::string> CollectSummariesFile(
+    "collect-summaries",
+    llvm::cl::desc("Phase 1: summarize the functions defined in the input files and merge them into <index>, no output is generated"),
+    llvm::cl::value_desc("index"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<std::string> SummariesFile(
+    "summaries",
+    llvm::cl::desc("Phase 2: taskify calls to functions defined in other files using the summaries of <index>"),
+    llvm::cl::value_desc("index"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> Instrument(
+    "instrument",
+    llvm::cl::desc("Count spawned and inlined tasks and time task bodies and taskwaits per call site, reported at exit when AUTOPAR_STATS is set"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> Trace(
+    "trace",
+    llvm::cl::desc("Record task bodies, taskwaits and taskgroups of the output into a Chrome trace written at exit to AUTOPAR_TRACE"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<std::string> ProfileFile(
+    "profile",
+    llvm::cl::desc("Serialize or cut off the task sites that AUTOPAR_PROFILE of an --instrument build found too small"),
+    llvm::cl::value_desc("profile"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<unsigned> ProfileMinTaskNs(
+    "profile-min-task-ns",
+    llvm::cl::desc("Average duration in nanoseconds below which --profile stops creating tasks at a depth"),
+    llvm::cl::init(10000),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> Adaptive(
+    "adaptive",
+    llvm::cl::desc("Tune the depth and NB limits of every parallelized function online from the time of its repeated invocations"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<std::string> OutputDir(
+    "output-dir",
+    llvm::cl::desc("Write the output of every input file to <dir> under its own name instead of output.cpp"),
+    llvm::cl::value_desc("dir"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<BackendKind> Backend(
+    "backend",
+    llvm::cl::desc("Task runtime targeted by the output"),
+    llvm::cl::values(
+        clEnumValN(BackendKind::OpenMP, "omp", "OpenMP tasks (default)"),
+        clEnumValN(BackendKind::WorkStealing, "ws", "the work-stealing scheduler of autopar_ws.hpp")),
+    llvm::cl::init(BackendKind::OpenMP),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> Numa(
+    "numa",
+    llvm::cl::desc("Spread the first touch of large allocations initialized serially over the threads, and add affinity clauses to the tasks"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> Simd(
+    "simd",
+    llvm::cl::desc("Annotate the innermost loops without calls that can be vectorized with #pragma omp simd, and report the others"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> Soa(
+    "soa",
+    llvm::cl::desc("Convert the std::vector members of plain structs accessed field by field in loops into structures of arrays"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<std::string> TaskGraphDir(
+    "task-graph",
+    llvm::cl::desc("Write the task graph of every parallelized function with its work, span and critical path as DOT and JSON into <dir>"),
+    llvm::cl::value_desc("dir"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> Memoize(
+    "memoize",
+    llvm::cl::desc("Cache the results of expensive pure functions with arithmetic arguments in bounded memo tables"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<unsigned> MemoizeMinCost(
+    "memoize-min-cost",
+    llvm::cl::desc("Static cost estimate from which --memoize caches the results of a pure function"),
+    llvm::cl::init(1000),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> EarlySpawn(
+    "early-spawn",
+    llvm::cl::desc("Move the statements creating tasks above the earlier statements of their block they don't depend on"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> ParallelStd(
+    "parallel-std",
+    llvm::cl::desc("Replace std::sort, std::transform, std::for_each and std::accumulate on random-access ranges with their task-parallel versions of the runtime"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<unsigned> ParallelStdMinSize(
+    "parallel-std-min-size",
+    llvm::cl::desc("Number of elements below which the algorithms replaced by --parallel-std run serially, and smallest part of a range a task handles"),
+    llvm::cl::init(10000),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> Cancel(
+    "cancel",
+    llvm::cl::desc("Cancel the pending tasks of a function returning early when they only compute its local variables, with OMP_CANCELLATION=true"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::opt<bool> Library(
+    "library",
+    llvm::cl::desc("Start a team in the exported functions creating tasks when they are called outside of a parallel region, for code without main"),
+    llvm::cl::cat(AutoparCategory));
+
+llvm::cl::list<std::string> EntryPoints(
+    "entry-points",
+    llvm::cl::desc("Functions starting a team when called outside of a parallel region, instead of the exported ones found by --library"),
+    llvm::cl::value_desc("f,g,..."),
+    llvm::cl::CommaSeparated,
+    llvm::cl::cat(AutoparCategory));
@@ -0,0 +1,91 @@
+#include <output.hpp>
+#include <instrumentation.hpp>
+#include <options.hpp>
+#include <replacements.hpp>
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Rewrite/Core/RewriteBuffer.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+/* output.cpp by default, the input file name in --output-dir so that several files can be transformed at once */
+std::string
+getOutputPath(StringRef mainFile) {
+    if (OutputDir.empty()) {
+        return "output.cpp";
+    }
+
+    llvm::SmallString<256> path(OutputDir);
+    llvm::sys::path::append(path, llvm::sys::path::filename(mainFile));
+    return std::string(path);
+}
+
+/* the includes and instrumentation written before the rewritten main file */
+std::string
+getOutputPrologue() {
+    std::string prologue = "#include <autopar_rt.hpp>\n";
+
+    if (Backend == BackendKind::WorkStealing) {
+        prologue += "#include <autopar_ws.hpp>\n";
+    }
+    if (Instrument || Trace) {
+        prologue += "\n" + getInstrumentationRuntime(Instrument, Trace);
+    }
+
+    return prologue + "\n\n\n";
+}
+
+bool
+emitParallelizedFile(const Rewriter &R, llvm::raw_ostream &OS) {
+    SourceManager &SM = R.getSourceMgr();
+    const RewriteBuffer *RewriteBuf = R.getRewriteBufferFor(SM.getMainFileID());
+
+    if (!RewriteBuf) {
+        llvm::errs() << "No rewrite buffer found.\n";
+        return false;
+    }
+
+    OS << getOutputPrologue();
+    RewriteBuf->write(OS);
+    OS << "\n";
+
+    return true;
+}
+
+bool
+writeParallelizedFile(const Rewriter &R) {
+    SourceManager &SM = R.getSourceMgr();
+    std::string outputFilePath = getOutputPath(SM.getFileEntryForID(SM.getMainFileID())->getName());
+
+    if (!R.getRewriteBufferFor(SM.getMainFileID())) {
+        llvm::errs() << "No rewrite buffer found.\n";
+        return false;
+    }
+
+    if (!OutputDir.empty() && llvm::sys::fs::create_directories(OutputDir)) {
+        llvm::errs() << "Error creating output directory: " << OutputDir << "\n";
+        return false;
+    }
+
+    std::error_code EC;
+    llvm::raw_fd_ostream outFile(outputFilePath, EC, llvm::sys::fs::OF_Text);
+
+    if (EC) {
+        llvm::errs() << "Error opening file for writing: " << outputFilePath << "\n";
+        return false;
+    }
+
+    return emitParallelizedFile(R, outFile);
+}
+
+/* output of both the one-shot driver and the daemon */
+bool
+writeOutput(const Rewriter &R) {
+    if (!ExportReplacementsDir.empty()) {
+        return exportReplacements(R, ExportReplacementsDir);
+    }
+
+    return writeParallelizedFile(R);
+}
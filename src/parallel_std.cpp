@@ -0,0 +1,377 @@
+#include <parallel_std.hpp>
+#include <options.hpp>
+#include <summaries.hpp>
+
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/DeclTemplate.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/Lex/Lexer.h>
+#include <llvm-18/llvm/Support/Casting.h>
+#include <map>
+#include <set>
+#include <vector>
+
+struct StdAlgorithm {
+    std::string replacement;
+    std::set<unsigned> arities; /* numbers of arguments of the overloads without execution policy */
+};
+
+static const std::map<std::string, StdAlgorithm> STD_ALGORITHMS = {
+    {"sort", {"AUTOPAR_ParallelSort", {2, 3}}},
+    {"transform", {"AUTOPAR_ParallelTransform", {4, 5}}},
+    {"for_each", {"AUTOPAR_ParallelForEach", {3}}},
+    {"accumulate", {"AUTOPAR_ParallelAccumulate", {3, 4}}}
+};
+
+/* function objects of <functional> applying a built-in operator to scalars */
+static const std::set<std::string> STD_OPERATORS = {
+    "plus", "minus", "multiplies", "divides", "modulus", "negate",
+    "equal_to", "not_equal_to", "greater", "less", "greater_equal", "less_equal",
+    "logical_and", "logical_or", "logical_not", "bit_and", "bit_or", "bit_xor", "bit_not"
+};
+
+/* those a reduction can be reassociated with */
+static const std::set<std::string> STD_ASSOCIATIVE_OPERATORS = {"plus", "multiplies", "bit_and", "bit_or", "bit_xor"};
+
+static std::string
+getText(const Expr *e, ASTContext &AC) {
+    CharSourceRange range = CharSourceRange::getTokenRange(e->getSourceRange());
+    return Lexer::getSourceText(range, AC.getSourceManager(), AC.getLangOpts()).str();
+}
+
+static bool
+isScalar(QualType type) {
+    return type->isArithmeticType() || type->isEnumeralType() || type->isPointerType();
+}
+
+static const TypedefNameDecl *
+getMemberType(const CXXRecordDecl *record, StringRef name, ASTContext &AC) {
+    for (const NamedDecl *decl : record->lookup(&AC.Idents.get(name))) {
+        if (const auto *type = llvm::dyn_cast<TypedefNameDecl>(decl)) return type;
+    }
+    return nullptr;
+}
+
+/*
+pointers, and classes with a random-access iterator_category whose reference is a true reference: the
+parts of a range handled by different tasks must not share the words of proxied elements (std::vector<bool>)
+*/
+static std::string
+checkIterator(const Expr *arg, QualType type, ASTContext &AC, QualType &element) {
+    type = type.getNonReferenceType().getCanonicalType();
+
+    if (type->isPointerType()) {
+        element = type->getPointeeType();
+        if (element->isVoidType() || element->isFunctionType()) return getText(arg, AC) + " is not an iterator";
+        return "";
+    }
+
+    const CXXRecordDecl *record = type->getAsCXXRecordDecl();
+    const TypedefNameDecl *category = record ? getMemberType(record, "iterator_category", AC) : nullptr;
+    const TypedefNameDecl *reference = record ? getMemberType(record, "reference", AC) : nullptr;
+    const TypedefNameDecl *value = record ? getMemberType(record, "value_type", AC) : nullptr;
+
+    const CXXRecordDecl *tag = category ? category->getUnderlyingType()->getAsCXXRecordDecl() : nullptr;
+    bool randomAccess = tag && tag->isInStdNamespace() && tag->getIdentifier()
+        && (tag->getName() == "random_access_iterator_tag" || tag->getName() == "contiguous_iterator_tag");
+
+    if (!randomAccess || !reference || !value) return getText(arg, AC) + " is not a random-access iterator";
+    if (!reference->getUnderlyingType()->isLValueReferenceType()) return "the elements of " + getText(arg, AC) + " are proxies";
+
+    element = value->getUnderlyingType().getCanonicalType();
+    return "";
+}
+
+/* a lambda stored in a local variable is analyzed at its definition */
+static const Expr *
+getFunctor(const Expr *e) {
+    e = e->IgnoreImplicit()->IgnoreParens();
+
+    if (const auto *construct = llvm::dyn_cast<CXXConstructExpr>(e)) {
+        if (construct->getNumArgs() == 1 && construct->getConstructor()->isCopyOrMoveConstructor()) {
+            e = construct->getArg(0)->IgnoreImplicit()->IgnoreParens();
+        }
+    }
+
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(e)) {
+        const auto *var = llvm::dyn_cast<VarDecl>(ref->getDecl());
+        const CXXRecordDecl *record = var ? var->getType()->getAsCXXRecordDecl() : nullptr;
+        if (record && record->isLambda() && var->hasLocalStorage() && var->getInit()) return getFunctor(var->getInit());
+    }
+
+    return e;
+}
+
+/* whether the expression whose parent is `parents[i - 1]` is loaded from, `parents[j - 1]` being the parent of `parents[j]` */
+static bool
+isLoaded(const std::vector<const Stmt *> &parents, std::size_t i) {
+    while (i > 0 && llvm::isa<ParenExpr>(parents[i - 1])) --i;
+    if (i == 0) return false;
+
+    const Stmt *parent = parents[i - 1];
+    if (const auto *cast = llvm::dyn_cast<ImplicitCastExpr>(parent)) {
+        if (cast->getCastKind() == CK_LValueToRValue) return true;
+        if (cast->getCastKind() == CK_ArrayToPointerDecay && i > 1 && llvm::isa<ArraySubscriptExpr>(parents[i - 2])) {
+            return isLoaded(parents, i - 2);
+        }
+        return false;
+    }
+    if (const auto *member = llvm::dyn_cast<MemberExpr>(parent)) {
+        return !member->isArrow() && isLoaded(parents, i - 1);
+    }
+    return llvm::isa<UnaryExprOrTypeTraitExpr>(parent);
+}
+
+/* `var` is only loaded from, directly or through subscripts and fields */
+static bool
+isOnlyRead(const Stmt *s, const VarDecl *var, std::vector<const Stmt *> &parents) {
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) {
+        return ref->getDecl() != var || isLoaded(parents, parents.size());
+    }
+
+    parents.push_back(s);
+    for (const Stmt *child : s->children()) {
+        if (child && !isOnlyRead(child, var, parents)) {
+            parents.pop_back();
+            return false;
+        }
+    }
+    parents.pop_back();
+
+    return true;
+}
+
+/* the function called on the elements writes nothing but the element it is passed by reference, if `writesElements` */
+static std::string
+checkCallable(const FunctionDecl *FD, bool writesElements, const std::string &name, ASTContext &AC) {
+    for (unsigned i = 0; i < FD->getNumParams(); ++i) {
+        if (getParameterEffect(FD, i, AC) != ParamEffect::Write) continue;
+        if (writesElements && i == 0 && FD->getParamDecl(0)->getType()->isReferenceType()) continue;
+
+        return name + " writes through its parameter " + FD->getParamDecl(i)->getNameAsString();
+    }
+
+    if (!isPureBody(FD, AC)) return name + " is not pure";
+    return "";
+}
+
+static std::string
+checkLambda(const LambdaExpr *lambda, bool writesElements, ASTContext &AC) {
+    if (lambda->isMutable()) return "the lambda is mutable";
+
+    for (const LambdaCapture &capture : lambda->captures()) {
+        if (capture.capturesThis()) return "the lambda captures this";
+        if (!capture.capturesVariable() || capture.getCaptureKind() != LCK_ByRef) continue;
+
+        const auto *var = llvm::dyn_cast<VarDecl>(capture.getCapturedVar());
+        std::vector<const Stmt *> parents;
+        if (var && !var->getType().isConstQualified() && !isOnlyRead(lambda->getBody(), var, parents)) {
+            return "the lambda writes " + var->getNameAsString() + ", captured by reference";
+        }
+    }
+
+    /* a generic lambda is checked for every type it is instantiated with */
+    std::vector<const FunctionDecl *> operators = {lambda->getCallOperator()};
+    if (const FunctionTemplateDecl *generic = lambda->getDependentCallOperator()) {
+        operators.assign(generic->spec_begin(), generic->spec_end());
+    }
+
+    for (const FunctionDecl *op : operators) {
+        std::string reason = checkCallable(op, writesElements, "the lambda", AC);
+        if (!reason.empty()) return reason;
+    }
+    return "";
+}
+
+/*
+function objects applied to the elements by several tasks at a time: lambdas reading what they capture by
+reference, pure functions, stateless classes, and the operators of <functional> on scalars
+*/
+static std::string
+checkFunctor(const Expr *arg, bool writesElements, bool scalars, ASTContext &AC) {
+    const Expr *e = getFunctor(arg);
+
+    if (const auto *lambda = llvm::dyn_cast<LambdaExpr>(e)) {
+        return checkLambda(lambda, writesElements, AC);
+    }
+
+    if (const auto *unary = llvm::dyn_cast<UnaryOperator>(e)) {
+        if (unary->getOpcode() == UO_AddrOf) e = unary->getSubExpr()->IgnoreParens();
+    }
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(e)) {
+        if (const auto *FD = llvm::dyn_cast<FunctionDecl>(ref->getDecl())) {
+            return checkCallable(FD, writesElements, FD->getNameAsString(), AC);
+        }
+    }
+
+    const CXXRecordDecl *record = e->getType()->getAsCXXRecordDecl();
+    if (!record || record->isLambda()) return getText(arg, AC) + " cannot be analyzed";
+
+    if (record->isInStdNamespace()) {
+        if (!record->getIdentifier() || !STD_OPERATORS.count(record->getNameAsString())) return getText(arg, AC) + " cannot be analyzed";
+        return scalars ? "" : "std::" + record->getNameAsString() + " is applied to elements of a class type";
+    }
+
+    auto calls = record->lookup(AC.DeclarationNames.getCXXOperatorName(OO_Call));
+    if (calls.empty()) return getText(arg, AC) + " cannot be analyzed";
+
+    for (const NamedDecl *decl : calls) {
+        const auto *method = llvm::dyn_cast<CXXMethodDecl>(decl);
+        if (!method) return getText(arg, AC) + " has a template call operator";
+        if (!method->isConst()) return getText(arg, AC) + " has a non-const call operator";
+
+        std::string reason = checkCallable(method, writesElements, record->getNameAsString() + "::operator()", AC);
+        if (!reason.empty()) return reason;
+    }
+    return "";
+}
+
+/* `a.begin()`, `std::begin(a)` and their const versions, returns `a` */
+static const Expr *
+getRangeOf(const Expr *e, StringRef side) {
+    e = e->IgnoreImplicit()->IgnoreParens();
+
+    if (const auto *construct = llvm::dyn_cast<CXXConstructExpr>(e)) {
+        if (construct->getNumArgs() == 1) e = construct->getArg(0)->IgnoreImplicit()->IgnoreParens();
+    }
+
+    const auto *call = llvm::dyn_cast<CallExpr>(e);
+    const FunctionDecl *callee = call ? call->getDirectCallee() : nullptr;
+    if (!callee || !callee->getIdentifier()) return nullptr;
+    if (callee->getName() != side && callee->getName() != ("c" + side).str()) return nullptr;
+
+    if (const auto *member = llvm::dyn_cast<CXXMemberCallExpr>(call)) {
+        return member->getImplicitObjectArgument()->IgnoreParenImpCasts();
+    }
+    return callee->isInStdNamespace() && call->getNumArgs() == 1 ? call->getArg(0)->IgnoreParenImpCasts() : nullptr;
+}
+
+/* number of elements of [first, last) when it is a constant: `a, a + N` or both ends of a fixed-size array */
+static bool
+getConstantLength(const Expr *first, const Expr *last, ASTContext &AC, long long &length) {
+    const Expr *end = last->IgnoreImplicit()->IgnoreParens();
+    const Expr *base = nullptr;
+    const Expr *offset = nullptr;
+
+    if (const auto *binary = llvm::dyn_cast<BinaryOperator>(end)) {
+        if (binary->getOpcode() == BO_Add) {
+            base = binary->getLHS();
+            offset = binary->getRHS();
+        }
+    } else if (const auto *op = llvm::dyn_cast<CXXOperatorCallExpr>(end)) {
+        if (op->getOperator() == OO_Plus && op->getNumArgs() == 2) {
+            base = op->getArg(0);
+            offset = op->getArg(1);
+        }
+    }
+
+    Expr::EvalResult result;
+    if (base && getText(base, AC) == getText(first, AC) && offset->EvaluateAsInt(result, AC)) {
+        length = result.Val.getInt().getSExtValue();
+        return true;
+    }
+
+    const auto *begin = llvm::dyn_cast_or_null<DeclRefExpr>(getRangeOf(first, "begin"));
+    const auto *endOf = llvm::dyn_cast_or_null<DeclRefExpr>(getRangeOf(last, "end"));
+    if (!begin || !endOf || begin->getDecl() != endOf->getDecl()) return false;
+
+    QualType type = begin->getType().getNonReferenceType();
+    if (const auto *array = AC.getAsConstantArrayType(type)) {
+        length = array->getSize().getSExtValue();
+        return true;
+    }
+
+    const auto *spec = llvm::dyn_cast_or_null<ClassTemplateSpecializationDecl>(type->getAsCXXRecordDecl());
+    if (spec && spec->isInStdNamespace() && spec->getName() == "array" && spec->getTemplateArgs().size() == 2
+        && spec->getTemplateArgs()[1].getKind() == TemplateArgument::Integral) {
+        length = spec->getTemplateArgs()[1].getAsIntegral().getSExtValue();
+        return true;
+    }
+
+    return false;
+}
+
+/* the overloads taking an execution policy are parallel already */
+static bool
+isExecutionPolicy(QualType type) {
+    const CXXRecordDecl *record = type.getNonReferenceType()->getAsCXXRecordDecl();
+    return record && record->getIdentifier() && record->getName().ends_with("_policy");
+}
+
+StdAlgorithmCall
+analyzeStdAlgorithmCall(const CallExpr *call, ASTContext &AC) {
+    StdAlgorithmCall result;
+
+    const FunctionDecl *callee = call->getDirectCallee();
+    if (!callee || !callee->isInStdNamespace() || !callee->getIdentifier()) return result;
+
+    auto it = STD_ALGORITHMS.find(callee->getNameAsString());
+    unsigned nbArgs = call->getNumArgs();
+    if (it == STD_ALGORITHMS.end() || !it->second.arities.count(nbArgs) || callee->getNumParams() != nbArgs) return result;
+    if (isExecutionPolicy(call->getArg(0)->getType())) return result;
+
+    std::string name = it->first;
+    result.algorithm = "std::" + name;
+    result.replacement = it->second.replacement;
+
+    const auto *calleeRef = llvm::dyn_cast<DeclRefExpr>(call->getCallee()->IgnoreParenImpCasts());
+    if (call->getBeginLoc().isMacroID() || !calleeRef) {
+        result.reason = "the call is written in a macro";
+        return result;
+    }
+    if (calleeRef->hasExplicitTemplateArgs()) {
+        result.reason = "the call has explicit template arguments";
+        return result;
+    }
+
+    /* the iterators come first, the function object last */
+    bool hasFunctor = !((name == "sort" && nbArgs == 2) || (name == "accumulate" && nbArgs == 3));
+    unsigned nbIterators = name == "accumulate" ? 2 : nbArgs - hasFunctor;
+
+    QualType element;
+    for (unsigned i = 0; i < nbIterators; ++i) {
+        QualType argElement;
+        result.reason = checkIterator(call->getArg(i), callee->getParamDecl(i)->getType(), AC, argElement);
+        if (!result.reason.empty()) return result;
+        if (i == 0) element = argElement;
+    }
+
+    bool scalars = isScalar(element);
+    if (name == "sort" && !hasFunctor && !scalars) {
+        result.reason = "elements of a class type are only sorted with a comparison function";
+        return result;
+    }
+
+    if (name == "accumulate") {
+        QualType init = callee->getParamDecl(2)->getType().getCanonicalType().getUnqualifiedType();
+        if (!element->isArithmeticType() || init != element.getUnqualifiedType()) {
+            result.reason = "the initial value (" + init.getAsString() + ") and the elements (" + element.getAsString()
+                + ") are not of the same arithmetic type";
+            return result;
+        }
+
+        /* floating-point operations aren't associative, a tree reduction would change the result */
+        if (!element->isIntegerType() || element->isEnumeralType()) {
+            result.reason = "accumulating " + element.getAsString() + " in a different order changes the result";
+            return result;
+        }
+
+        const CXXRecordDecl *op = hasFunctor ? getFunctor(call->getArg(3))->getType()->getAsCXXRecordDecl() : nullptr;
+        if (hasFunctor && !(op && op->isInStdNamespace() && op->getIdentifier() && STD_ASSOCIATIVE_OPERATORS.count(op->getNameAsString()))) {
+            result.reason = "the operation is not known to be associative";
+            return result;
+        }
+    } else if (hasFunctor) {
+        result.reason = checkFunctor(call->getArg(nbArgs - 1), name == "for_each", scalars, AC);
+        if (!result.reason.empty()) return result;
+    }
+
+    long long length;
+    if (getConstantLength(call->getArg(0), call->getArg(1), AC, length) && length < ParallelStdMinSize) {
+        result.reason = "the range has only " + std::to_string(length) + " elements";
+        return result;
+    }
+
+    result.legal = true;
+    return result;
+}
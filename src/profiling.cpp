@@ -0,0 +1,76 @@
+#include <profiling.hpp>
+#include <options.hpp>
+
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+static llvm::TimerGroup &
+getTimerGroup() {
+    static llvm::TimerGroup group("autopar", "autopar per-phase timing");
+    return group;
+}
+
+void
+startProfiling(llvm::StringRef procName) {
+    if (!TimeTrace) return;
+
+    llvm::timeTraceProfilerInitialize(TimeTraceGranularity, procName);
+}
+
+void
+finishProfiling() {
+    if (!TimeTrace || !llvm::timeTraceProfilerEnabled()) return;
+
+    if (auto err = llvm::timeTraceProfilerWrite(TimeTraceFile, "autopar")) {
+        llvm::errs() << "Error writing time trace: " << llvm::toString(std::move(err)) << "\n";
+    }
+
+    llvm::timeTraceProfilerCleanup();
+}
+
+llvm::Timer *
+getPhaseTimer(Phase phase) {
+    if (!TimeTrace) return nullptr;
+
+    static llvm::Timer frontend("frontend", "Parsing (includes task creation)", getTimerGroup());
+    static llvm::Timer taskCreation("taskcreation", "Task creation and dependency analysis", getTimerGroup());
+    static llvm::Timer output("output", "Output", getTimerGroup());
+
+    switch (phase) {
+    case Phase::Frontend:
+        return &frontend;
+    case Phase::TaskCreation:
+        return &taskCreation;
+    case Phase::Output:
+        return &output;
+    }
+
+    return nullptr;
+}
+
+void
+printSummary(llvm::StringRef file, const TaskCreationStats &stats) {
+    if (!TimeTrace) return;
+
+    llvm::outs() << "*** Summary for: " << file << "\n"
+                 << "    functions (taskgroups)  " << stats.functions << "\n"
+                 << "    user call sites         " << stats.callSites << "\n"
+                 << "    tasks                   " << stats.tasks << "\n"
+                 << "    taskwaits               " << stats.taskwaits << "\n"
+                 << "    reused pure calls       " << stats.reusedCalls << "\n"
+                 << "    decomposed calls        " << stats.decomposedCalls << "\n"
+                 << "    cancelling returns      " << stats.cancellingReturns << "\n"
+                 << "    entry points            " << stats.entryPoints << "\n";
+
+    if (Simd) {
+        llvm::outs() << "    simd loops              " << stats.simdLoops << "\n"
+                     << "    rejected loops          " << stats.simdRejected << "\n";
+    }
+
+    if (ParallelStd) {
+        llvm::outs() << "    parallel std calls      " << stats.parallelStdCalls << "\n"
+                     << "    rejected std calls      " << stats.parallelStdRejected << "\n";
+    }
+
+    getTimerGroup().print(llvm::outs(), true);
+}
@@ -0,0 +1,194 @@
+#include <pure_calls.hpp>
+#include <options.hpp>
+#include <summaries.hpp>
+
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/AST/ParentMapContext.h>
+#include <clang/Lex/Lexer.h>
+#include <llvm-18/llvm/Support/Casting.h>
+#include <algorithm>
+
+static bool
+isScalar(QualType type) {
+    return type->isArithmeticType() || type->isEnumeralType();
+}
+
+/* literals and reads of local scalar variables, combined by operators without side effects */
+static bool
+readsOnlyLocalScalars(const Stmt *s, std::vector<const VarDecl *> &vars) {
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) {
+        if (llvm::isa<EnumConstantDecl>(ref->getDecl())) return true;
+
+        const auto *VD = llvm::dyn_cast<VarDecl>(ref->getDecl());
+        if (!VD || !VD->hasLocalStorage() || VD->getType()->isReferenceType() || !isScalar(VD->getType())) return false;
+
+        vars.push_back(VD);
+        return true;
+    }
+
+    if (const auto *unary = llvm::dyn_cast<UnaryOperator>(s)) {
+        if (unary->isIncrementDecrementOp() || unary->getOpcode() == UO_AddrOf || unary->getOpcode() == UO_Deref) return false;
+    } else if (const auto *binary = llvm::dyn_cast<BinaryOperator>(s)) {
+        if (binary->isAssignmentOp() || binary->isCommaOp()) return false;
+    } else if (const auto *cast = llvm::dyn_cast<ImplicitCastExpr>(s)) {
+        if (cast->getCastKind() != CK_LValueToRValue && !isScalar(cast->getType())) return false;
+    } else if (!llvm::isa<IntegerLiteral>(s) && !llvm::isa<FloatingLiteral>(s) && !llvm::isa<CharacterLiteral>(s)
+               && !llvm::isa<CXXBoolLiteralExpr>(s) && !llvm::isa<ParenExpr>(s) && !llvm::isa<ConditionalOperator>(s)
+               && !llvm::isa<CStyleCastExpr>(s) && !llvm::isa<CXXStaticCastExpr>(s)) {
+        return false;
+    }
+
+    for (const Stmt *child : s->children()) {
+        if (child && !readsOnlyLocalScalars(child, vars)) return false;
+    }
+    return true;
+}
+
+bool
+getPureCall(const FunctionDecl *callee, const CallExpr *call, const VarDecl *result, const DeclStmt *decl, ASTContext &AC, PureCall &pureCall) {
+    if (result->getType()->isReferenceType() || call->getBeginLoc().isMacroID()) return false;
+    if (!isPureFunction(callee, AC)) return false;
+
+    pureCall.callee = callee->getCanonicalDecl();
+    pureCall.result = result;
+    pureCall.decl = decl;
+
+    for (const Expr *arg : call->arguments()) {
+        if (llvm::isa<CXXDefaultArgExpr>(arg)) continue;
+        if (!readsOnlyLocalScalars(arg, pureCall.vars)) return false;
+
+        CharSourceRange range = CharSourceRange::getTokenRange(arg->getSourceRange());
+        pureCall.args.push_back(Lexer::getSourceText(range, AC.getSourceManager(), AC.getLangOpts()).str());
+    }
+
+    return true;
+}
+
+std::string
+getPureCallText(const PureCall &pureCall) {
+    std::string text = pureCall.callee->getNameAsString() + "(";
+    for (std::size_t i = 0; i < pureCall.args.size(); ++i) {
+        text += (i ? ", " : "") + pureCall.args[i];
+    }
+    return text + ")";
+}
+
+/*
+whether `var` keeps its value between `from` and `to`: every use in between is a read, and the other
+uses are reads or plain assignments, so that no pointer, reference or lambda can write it in between
+*/
+static bool
+isUnchangedBetween(const Stmt *s, const Stmt *parent, const VarDecl *var, SourceLocation from, SourceLocation to, const SourceManager &SM) {
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) {
+        if (ref->getDecl() != var) return true;
+
+        const auto *cast = llvm::dyn_cast_or_null<ImplicitCastExpr>(parent);
+        if (cast && cast->getCastKind() == CK_LValueToRValue) return true;
+        if (parent && llvm::isa<UnaryExprOrTypeTraitExpr>(parent)) return true;
+
+        bool between = SM.isBeforeInTranslationUnit(from, ref->getLocation()) && SM.isBeforeInTranslationUnit(ref->getLocation(), to);
+        if (between) return false;
+
+        if (const auto *unary = llvm::dyn_cast_or_null<UnaryOperator>(parent)) return unary->isIncrementDecrementOp();
+        if (const auto *binary = llvm::dyn_cast_or_null<BinaryOperator>(parent)) {
+            return binary->isAssignmentOp() && binary->getLHS()->IgnoreParens() == ref;
+        }
+        return false;
+    }
+
+    for (const Stmt *child : s->children()) {
+        if (child && !isUnchangedBetween(child, llvm::isa<ParenExpr>(s) ? parent : s, var, from, to, SM)) return false;
+    }
+    return true;
+}
+
+static const Stmt *
+getParentStmt(const Stmt *s, ASTContext &AC) {
+    auto parents = AC.getParentMapContext().getParents(*s);
+    return parents.empty() ? nullptr : parents[0].get<Stmt>();
+}
+
+/*
+an earlier declaration of the same block computes the same value if it called the same pure function
+with the same arguments, and neither the arguments nor its variable changed since
+*/
+const PureCall *
+findReusableCall(const std::vector<PureCall> &earlier, const PureCall &pureCall, const FunctionDecl *function, ASTContext &AC) {
+    const SourceManager &SM = AC.getSourceManager();
+    const Stmt *block = getParentStmt(pureCall.decl, AC);
+    if (!block || !llvm::isa<CompoundStmt>(block)) return nullptr;
+
+    QualType type = pureCall.result->getType().getCanonicalType().getUnqualifiedType();
+
+    for (auto it = earlier.rbegin(); it != earlier.rend(); ++it) {
+        if (it->callee != pureCall.callee || it->args != pureCall.args) continue;
+        if (it->result->getType().getCanonicalType().getUnqualifiedType() != type) continue;
+        if (getParentStmt(it->decl, AC) != block) continue;
+
+        SourceLocation from = it->decl->getEndLoc();
+        SourceLocation to = pureCall.decl->getBeginLoc();
+
+        std::vector<const VarDecl *> vars = it->vars;
+        vars.push_back(it->result);
+
+        bool unchanged = std::all_of(vars.begin(), vars.end(), [&](const VarDecl *var) {
+            return isUnchangedBetween(function->getBody(), nullptr, var, from, to, SM);
+        });
+        if (unchanged) return &*it;
+    }
+
+    return nullptr;
+}
+
+/* arithmetic and enumeration types, by value or by const reference */
+static bool
+isMemoKey(QualType type) {
+    if (type->isReferenceType()) {
+        type = type.getNonReferenceType();
+        if (!type.isConstQualified()) return false;
+    }
+    return isScalar(type);
+}
+
+static bool
+isMemoValue(QualType type, ASTContext &AC) {
+    if (type->isReferenceType() || type->isVoidType()) return false;
+    if (isScalar(type)) return true;
+
+    const CXXRecordDecl *record = type->getAsCXXRecordDecl();
+    return record && record->hasDefaultConstructor() && type.isTriviallyCopyableType(AC);
+}
+
+/*
+pure functions whose static cost estimate reaches --memoize-min-cost and whose results are worth keeping,
+that is copied out of a table indexed by arguments that can be hashed and compared bitwise
+*/
+bool
+canMemoize(const FunctionDecl *FD, ASTContext &AC) {
+    if (FD->isMain() || FD->isTemplated() || FD->isVariadic() || FD->isConstexpr()) return false;
+    if (!isMemoValue(FD->getReturnType(), AC)) return false;
+
+    for (const ParmVarDecl *param : FD->parameters()) {
+        if (!param->getIdentifier() || !isMemoKey(param->getType())) return false;
+    }
+
+    return isPureFunction(FD, AC) && estimateCost(FD, AC) >= MemoizeMinCost;
+}
+
+/* the key is taken before the body may change the parameters */
+std::string
+getMemoPrologue(const FunctionDecl *FD, ASTContext &AC) {
+    std::string result = FD->getReturnType().getUnqualifiedType().getAsString(AC.getPrintingPolicy());
+    std::string types = result, args;
+
+    for (const ParmVarDecl *param : FD->parameters()) {
+        types += ", " + param->getType().getNonReferenceType().getUnqualifiedType().getAsString(AC.getPrintingPolicy());
+        args += (args.empty() ? "" : ", ") + param->getNameAsString();
+    }
+
+    return "\nstatic AUTOPAR_Memo<" + types + "> AUTOPAR_memo;"
+           "\nconst auto AUTOPAR_key = AUTOPAR_memo.key(" + args + ");"
+           "\n" + result + " AUTOPAR_memoized;"
+           "\nif (AUTOPAR_memo.find(AUTOPAR_key, AUTOPAR_memoized)) return AUTOPAR_memoized;\n";
+}
@@ -0,0 +1,106 @@
+#include <replacements.hpp>
+#include <output.hpp>
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Rewrite/Core/RewriteBuffer.h>
+#include <clang/Tooling/Core/Replacement.h>
+#include <clang/Tooling/ReplacementsYaml.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/YAMLTraits.h>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+#include <vector>
+
+/*
+the edits of the rewriter: every character of the original buffer is looked up in the rewritten text
+through the rewriter's own offset mapping, the replacements are the regions between those it kept.
+`shift` is the length of the text written before the buffer
+*/
+static std::vector<tooling::Replacement>
+getEdits(const Rewriter &R, FileID FID, StringRef filePath, StringRef rewritten, unsigned shift) {
+    SourceManager &SM = R.getSourceMgr();
+    StringRef original = SM.getBufferData(FID);
+    SourceLocation start = SM.getLocForStartOfFile(FID);
+
+    std::vector<tooling::Replacement> replacements;
+    unsigned originalStart = 0;
+    unsigned rewrittenStart = 0;
+
+    auto flush = [&](unsigned originalEnd, unsigned rewrittenEnd) {
+        if (originalEnd > originalStart || rewrittenEnd > rewrittenStart) {
+            replacements.emplace_back(filePath, originalStart, originalEnd - originalStart,
+                                      rewritten.slice(rewrittenStart, rewrittenEnd));
+        }
+    };
+
+    for (unsigned offset = 0; offset < original.size(); ++offset) {
+        /* the size of the rewritten text before the character, including what was inserted in front of it */
+        int mapped = R.getRangeSize(CharSourceRange::getCharRange(start, start.getLocWithOffset(offset)));
+        if (mapped < 0) continue;
+
+        unsigned position = mapped + shift;
+        if (position < rewrittenStart || position >= rewritten.size() || rewritten[position] != original[offset]) continue;
+
+        flush(offset, position);
+        originalStart = offset + 1;
+        rewrittenStart = position + 1;
+    }
+    flush(original.size(), rewritten.size());
+
+    return replacements;
+}
+
+bool
+exportReplacements(const Rewriter &R, StringRef directory) {
+    SourceManager &SM = R.getSourceMgr();
+    FileID MainFileId = SM.getMainFileID();
+
+    llvm::SmallString<256> mainFile(SM.getFilename(SM.getLocForStartOfFile(MainFileId)));
+    llvm::sys::fs::make_absolute(mainFile);
+
+    tooling::TranslationUnitReplacements TUReplacements;
+    TUReplacements.MainSourceFile = std::string(mainFile.str());
+
+    for (auto it = R.buffer_begin(), end = R.buffer_end(); it != end; ++it) {
+        llvm::SmallString<256> filePath(SM.getFilename(SM.getLocForStartOfFile(it->first)));
+        llvm::sys::fs::make_absolute(filePath);
+
+        std::string rewritten;
+        llvm::raw_string_ostream OS(rewritten);
+        if (it->first == MainFileId) {
+            if (!emitParallelizedFile(R, OS)) return false;
+        } else {
+            it->second.write(OS);
+        }
+
+        unsigned shift = it->first == MainFileId ? getOutputPrologue().size() : 0;
+        auto replacements = getEdits(R, it->first, filePath, OS.str(), shift);
+        TUReplacements.Replacements.insert(TUReplacements.Replacements.end(), replacements.begin(), replacements.end());
+    }
+
+    if (std::error_code EC = llvm::sys::fs::create_directories(directory)) {
+        llvm::errs() << "Error creating directory " << directory << ": " << EC.message() << "\n";
+        return false;
+    }
+
+    /* one file per TU, named after the main file so shards never collide */
+    llvm::SmallString<256> outputFilePath(directory);
+    llvm::sys::path::append(outputFilePath, llvm::sys::path::stem(mainFile) + "-" + llvm::utohexstr(llvm::hash_value(mainFile.str())) + ".yaml");
+
+    std::error_code EC;
+    llvm::raw_fd_ostream outFile(outputFilePath, EC, llvm::sys::fs::OF_Text);
+
+    if (EC) {
+        llvm::errs() << "Error opening file for writing: " << outputFilePath << "\n";
+        return false;
+    }
+
+    llvm::yaml::Output YAML(outFile);
+    YAML << TUReplacements;
+
+    return true;
+}
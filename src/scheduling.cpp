@@ -0,0 +1,264 @@
+#include <scheduling.hpp>
+#include <concepts.hpp>
+#include <summaries.hpp>
+
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/AST/ParentMapContext.h>
+#include <clang/AST/StmtCXX.h>
+#include <clang/Lex/Lexer.h>
+#include <llvm-18/llvm/Support/Casting.h>
+#include <llvm-18/llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <map>
+#include <set>
+
+/* names of the standard library functions and classes with a state outside of their arguments */
+static const std::vector<std::string> GLOBAL_STATE_NAMES = {
+    "stream", "ios", "print", "scan", "puts", "rand", "time", "clock", "sleep", "exit", "abort"
+};
+
+/* what a statement does, by variable name */
+struct Effects {
+    std::set<std::string> reads;
+    std::set<std::string> writes;
+    bool pointers = false; /* goes through pointers or references, which may reach any array */
+    bool arrays = false;
+    bool barrier = false;  /* can't be reordered with anything */
+};
+
+static const Stmt *
+getParentStmt(const Stmt *s, ASTContext &AC) {
+    auto parents = AC.getParentMapContext().getParents(*s);
+    return parents.empty() ? nullptr : parents[0].get<Stmt>();
+}
+
+/* `s`, or the full expression around it, when it is a statement of a block */
+const Stmt *
+getBlockStatement(const Stmt *s, ASTContext &AC) {
+    const Stmt *parent = getParentStmt(s, AC);
+    if (parent && llvm::isa<ExprWithCleanups>(parent)) {
+        s = parent;
+        parent = getParentStmt(s, AC);
+    }
+    return parent && llvm::isa<CompoundStmt>(parent) ? s : nullptr;
+}
+
+static bool
+hasGlobalStateName(StringRef name) {
+    for (const std::string &part : GLOBAL_STATE_NAMES) {
+        if (name.contains(part)) return true;
+    }
+    return false;
+}
+
+/*
+calls whose effects are limited to their arguments: the user functions, which the tasks already assume,
+the pure math functions and the standard library except I/O, random numbers and time
+*/
+static bool
+isLocalCall(const CallExpr *call, ASTContext &AC) {
+    const FunctionDecl *callee = call->getDirectCallee();
+    if (!callee) return false;
+    if (getTaskCallee(call) || isPureLibraryFunction(callee, AC)) return true;
+    if (!callee->isInStdNamespace() || hasGlobalStateName(callee->getNameAsString())) return false;
+
+    if (const auto *method = llvm::dyn_cast<CXXMethodDecl>(callee)) {
+        if (hasGlobalStateName(method->getParent()->getNameAsString())) return false;
+    }
+    for (const Expr *arg : call->arguments()) {
+        const CXXRecordDecl *record = arg->getType()->getAsCXXRecordDecl();
+        if (record && hasGlobalStateName(record->getNameAsString())) return false;
+    }
+    return true;
+}
+
+static void
+addVariable(const VarDecl *var, bool value, Effects &effects) {
+    QualType type = var->getType();
+
+    if (var->hasGlobalStorage() && !type.isConstQualified()) effects.barrier = true;
+    if (type->isPointerType() || type->isReferenceType()) effects.pointers = true;
+    if (type->isArrayType()) effects.arrays = true;
+
+    (value ? effects.reads : effects.writes).insert(var->getNameAsString());
+}
+
+/* variables used as values are read, the other uses may write them. `loops` counts the enclosing loops and switches of `s` */
+static void
+collectEffects(const Stmt *s, bool value, int loops, ASTContext &AC, Effects &effects) {
+    if (llvm::isa<ReturnStmt>(s) || llvm::isa<GotoStmt>(s) || llvm::isa<IndirectGotoStmt>(s) || llvm::isa<LabelStmt>(s)
+        || llvm::isa<SwitchCase>(s) || llvm::isa<CXXThrowExpr>(s) || llvm::isa<CXXTryStmt>(s) || llvm::isa<AsmStmt>(s)) {
+        effects.barrier = true;
+        return;
+    }
+
+    if ((llvm::isa<BreakStmt>(s) || llvm::isa<ContinueStmt>(s)) && loops == 0) {
+        effects.barrier = true;
+        return;
+    }
+
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) {
+        if (const auto *var = llvm::dyn_cast<VarDecl>(ref->getDecl())) {
+            addVariable(var, value, effects);
+        }
+        return;
+    }
+
+    if (const auto *decl = llvm::dyn_cast<DeclStmt>(s)) {
+        for (const Decl *d : decl->decls()) {
+            if (const auto *var = llvm::dyn_cast<VarDecl>(d)) {
+                if (var->isStaticLocal()) effects.barrier = true;
+                addVariable(var, false, effects);
+            }
+        }
+    } else if (const auto *call = llvm::dyn_cast<CallExpr>(s)) {
+        if (!isLocalCall(call, AC)) effects.barrier = true;
+    } else if (llvm::isa<CXXThisExpr>(s) || llvm::isa<CXXNewExpr>(s) || llvm::isa<CXXDeleteExpr>(s)) {
+        effects.pointers = true;
+    } else if (const auto *cast = llvm::dyn_cast<ImplicitCastExpr>(s)) {
+        collectEffects(cast->getSubExpr(), cast->getCastKind() == CK_LValueToRValue, loops, AC, effects);
+        return;
+    } else if (const auto *paren = llvm::dyn_cast<ParenExpr>(s)) {
+        collectEffects(paren->getSubExpr(), value, loops, AC, effects);
+        return;
+    } else if (const auto *member = llvm::dyn_cast<MemberExpr>(s)) {
+        if (member->isArrow()) effects.pointers = true;
+        collectEffects(member->getBase(), value && !member->isArrow(), loops, AC, effects);
+        return;
+    }
+
+    bool loop = llvm::isa<ForStmt>(s) || llvm::isa<WhileStmt>(s) || llvm::isa<DoStmt>(s)
+        || llvm::isa<CXXForRangeStmt>(s) || llvm::isa<SwitchStmt>(s);
+
+    for (const Stmt *child : s->children()) {
+        if (child) collectEffects(child, false, loops + loop, AC, effects);
+    }
+}
+
+static Effects
+getEffects(const Stmt *s, ASTContext &AC) {
+    Effects effects;
+    collectEffects(s, false, 0, AC, effects);
+    return effects;
+}
+
+static bool
+intersects(const std::set<std::string> &a, const std::set<std::string> &b) {
+    for (const auto &name : a) {
+        if (b.count(name)) return true;
+    }
+    return false;
+}
+
+static bool
+conflicts(const Effects &a, const Effects &b) {
+    if (a.barrier || b.barrier) return true;
+    if (intersects(a.writes, b.reads) || intersects(a.writes, b.writes) || intersects(b.writes, a.reads)) return true;
+
+    return (a.pointers && (b.pointers || b.arrays)) || (b.pointers && a.arrays);
+}
+
+static bool
+hasBarrier(const Stmt *s, const std::vector<SourceLocation> &barriers, const SourceManager &SM) {
+    for (SourceLocation loc : barriers) {
+        if (SM.isPointWithin(loc, s->getBeginLoc(), s->getEndLoc())) return true;
+    }
+    return false;
+}
+
+/* the statement with the text inserted around it, up to its semicolon */
+static CharSourceRange
+getStatementRange(const Stmt *s, ASTContext &AC) {
+    SourceLocation end = llvm::isa<DeclStmt>(s)
+        ? s->getEndLoc().getLocWithOffset(1)
+        : Lexer::findLocationAfterToken(s->getEndLoc(), tok::semi, AC.getSourceManager(), AC.getLangOpts(), false);
+    return CharSourceRange::getCharRange(s->getBeginLoc(), end);
+}
+
+static std::string
+getSpawnName(const Stmt *s) {
+    const auto *call = llvm::dyn_cast<CallExpr>(s->IgnoreContainers());
+    if (!call || !getTaskCallee(call)) call = findCallExpr(s);
+
+    const FunctionDecl *callee = call ? getTaskCallee(call) : nullptr;
+    return callee ? callee->getNameAsString() : "statement";
+}
+
+/*
+a statement creating tasks moves above the statements before it in its block as long as they use none
+of the variables it writes and write none of those it uses, and no taskwait was inserted on the way.
+A statement stopped by a moved one follows it when it could pass what the moved one passed. Consumers
+stay in place and wait for the tasks through their depend clauses or taskwaits
+*/
+void
+spawnEarly(const std::vector<const Stmt *> &spawns, const std::vector<SourceLocation> &barriers, ASTContext &AC, Rewriter &RW) {
+    SourceManager &SM = AC.getSourceManager();
+    std::set<const Stmt *> spawning(spawns.begin(), spawns.end());
+    std::map<const Stmt *, const Stmt *> targets; /* moved statement -> statement it is placed before */
+    std::vector<const Stmt *> moved;
+
+    for (const Stmt *spawn : spawns) {
+        const auto *block = llvm::dyn_cast_or_null<CompoundStmt>(getParentStmt(spawn, AC));
+        if (!block || spawn->getBeginLoc().isMacroID() || hasBarrier(spawn, barriers, SM)) continue;
+        if (getStatementRange(spawn, AC).getEnd().isInvalid()) continue;
+
+        Effects effects = getEffects(spawn, AC);
+        if (effects.barrier) continue;
+
+        std::vector<const Stmt *> body(block->body_begin(), block->body_end());
+        int index = std::find(body.begin(), body.end(), spawn) - body.begin();
+        if (index == int(body.size())) continue;
+
+        auto passes = [&](const Stmt *s) {
+            return !s->getBeginLoc().isMacroID() && !hasBarrier(s, barriers, SM) && !conflicts(effects, getEffects(s, AC));
+        };
+
+        int target = index;
+        while (target > 0 && passes(body[target - 1])) --target;
+
+        /* behind a moved statement it depends on, if it can pass what that one passed */
+        if (target > 0 && targets.count(body[target - 1])) {
+            const Stmt *previous = body[target - 1];
+            int previousTarget = std::find(body.begin(), body.end(), targets[previous]) - body.begin();
+            bool follows = true;
+            for (int i = previousTarget; i < target - 1 && follows; ++i) {
+                follows = (targets.count(body[i]) && targets[body[i]] == targets[previous]) || passes(body[i]);
+            }
+            if (follows) target = previousTarget;
+        }
+
+        /* nothing is gained by passing other tasks only */
+        bool gain = false;
+        for (int i = target; i < index; ++i) {
+            gain |= !spawning.count(body[i]);
+        }
+        if (!gain) continue;
+
+        targets[spawn] = body[target];
+        moved.push_back(spawn);
+
+        llvm::outs() << "Early spawn: " << getSpawnName(spawn) << " at line " << SM.getPresumedLineNumber(spawn->getBeginLoc())
+                     << " moved above line " << SM.getPresumedLineNumber(body[target]->getBeginLoc()) << "\n";
+    }
+
+    /* texts are taken before anything is removed, and all are removed before being inserted again */
+    std::vector<std::string> texts;
+    for (const Stmt *spawn : moved) {
+        texts.push_back(RW.getRewrittenText(getStatementRange(spawn, AC)));
+    }
+    for (const Stmt *spawn : moved) {
+        RW.RemoveText(getStatementRange(spawn, AC));
+    }
+
+    std::map<const Stmt *, std::string> inserted;
+    std::vector<const Stmt *> order;
+    for (std::size_t i = 0; i < moved.size(); ++i) {
+        const Stmt *target = targets[moved[i]];
+        if (!inserted.count(target)) order.push_back(target);
+        inserted[target] += texts[i] + "\n";
+    }
+    for (const Stmt *target : order) {
+        RW.InsertText(target->getBeginLoc(), inserted[target], false, true);
+    }
+}
@@ -0,0 +1,600 @@
+#include <simd.hpp>
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/AST/StmtCXX.h>
+#include <clang/Lex/Lexer.h>
+#include <llvm-18/llvm/Support/Casting.h>
+#include <map>
+#include <set>
+
+/* calls that do not prevent vectorization, compilers have vector variants of them */
+static const std::set<std::string> SIMD_MATH_FUNCTIONS = {
+    "sqrt", "cbrt", "exp", "exp2", "expm1", "log", "log2", "log10", "log1p", "pow",
+    "sin", "cos", "tan", "asin", "acos", "atan", "atan2", "sinh", "cosh", "tanh",
+    "fabs", "abs", "fmin", "fmax", "floor", "ceil", "trunc", "round", "fma", "hypot",
+    "min", "max"
+};
+
+/* containers whose operator[] is a plain access to contiguous elements */
+static const std::set<std::string> SIMD_CONTAINERS = {"vector", "array", "span", "valarray"};
+
+enum class AccessKind {
+    Read,
+    Write,
+    Update  /* compound assignment */
+};
+
+/* a memory access of the loop body, to a scalar or to an element of an array */
+struct Access {
+    std::string key;                    /* array and fields accessed, or the whole lvalue when it isn't subscripted */
+    std::string base;                   /* subscripted array, empty for scalars */
+    const Expr *baseExpr = nullptr;
+    const Expr *index = nullptr;
+    const Expr *lvalue = nullptr;
+    const VarDecl *variable = nullptr;  /* scalar variable accessed as a whole */
+    AccessKind kind = AccessKind::Read;
+    std::string op;                     /* reduction operator of an update, empty if not associative */
+};
+
+struct LoopBody {
+    const VarDecl *loopVar;
+    ASTContext &AC;
+    const Rewriter &RW;
+    std::set<const VarDecl *> locals;
+    std::vector<Access> accesses;
+    std::string reason;
+};
+
+static void collectExpr(const Expr *, LoopBody &);
+
+static std::string
+getText(const Expr *e, const Rewriter &RW) {
+    return RW.getRewrittenText(e->getSourceRange());
+}
+
+static const VarDecl *
+asVariable(const Expr *e) {
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(e->IgnoreParenImpCasts())) {
+        return llvm::dyn_cast<VarDecl>(ref->getDecl());
+    }
+    return nullptr;
+}
+
+static bool
+referencesAny(const Stmt *s, const std::set<const VarDecl *> &vars) {
+    if (!s) return false;
+
+    if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(s)) {
+        const auto *var = llvm::dyn_cast<VarDecl>(ref->getDecl());
+        return var && vars.count(var);
+    }
+
+    for (const Stmt *Child : s->children()) {
+        if (referencesAny(Child, vars)) return true;
+    }
+
+    return false;
+}
+
+static bool
+isContainerSubscript(const CXXOperatorCallExpr *op) {
+    if (op->getOperator() != OO_Subscript) return false;
+
+    const CXXRecordDecl *record = op->getArg(0)->getType()->getAsCXXRecordDecl();
+    return record && record->isInStdNamespace() && SIMD_CONTAINERS.count(record->getNameAsString());
+}
+
+/* canonical loop `for (i = a; i < b; i += step)`, returns the loop variable */
+static const VarDecl *
+getLoopVariable(const ForStmt *loop, ASTContext &AC, long long &step) {
+    const VarDecl *var = nullptr;
+
+    if (const auto *decl = llvm::dyn_cast_or_null<DeclStmt>(loop->getInit())) {
+        if (decl->isSingleDecl()) var = llvm::dyn_cast<VarDecl>(decl->getSingleDecl());
+    } else if (const auto *assign = llvm::dyn_cast_or_null<BinaryOperator>(loop->getInit())) {
+        if (assign->getOpcode() == BO_Assign) var = asVariable(assign->getLHS());
+    }
+
+    if (!var || !var->getType()->isIntegerType() || !loop->getInc() || !loop->getCond()) return nullptr;
+
+    const Expr *inc = loop->getInc()->IgnoreParenImpCasts();
+    if (const auto *unary = llvm::dyn_cast<UnaryOperator>(inc)) {
+        if (!unary->isIncrementDecrementOp() || asVariable(unary->getSubExpr()) != var) return nullptr;
+        step = unary->isIncrementOp() ? 1 : -1;
+    } else if (const auto *compound = llvm::dyn_cast<CompoundAssignOperator>(inc)) {
+        Expr::EvalResult result;
+        if (asVariable(compound->getLHS()) != var || !compound->getRHS()->EvaluateAsInt(result, AC)) return nullptr;
+
+        long long value = result.Val.getInt().getSExtValue();
+        if (compound->getOpcode() == BO_AddAssign) {
+            step = value;
+        } else if (compound->getOpcode() == BO_SubAssign) {
+            step = -value;
+        } else {
+            return nullptr;
+        }
+    } else {
+        return nullptr;
+    }
+
+    const auto *cond = llvm::dyn_cast<BinaryOperator>(loop->getCond()->IgnoreParenImpCasts());
+    if (step == 0 || !cond || (!cond->isRelationalOp() && cond->getOpcode() != BO_NE)) return nullptr;
+    if (asVariable(cond->getLHS()) != var && asVariable(cond->getRHS()) != var) return nullptr;
+
+    return var;
+}
+
+static void
+addAccess(const Expr *lvalue, AccessKind kind, const std::string &op, LoopBody &body) {
+    lvalue = lvalue->IgnoreParenImpCasts();
+
+    Access access;
+    access.lvalue = lvalue;
+    access.kind = kind;
+    access.op = op;
+
+    /* fields of an element or of a variable, `particles[i].x` */
+    const Expr *e = lvalue;
+    std::string fields;
+    while (const auto *member = llvm::dyn_cast<MemberExpr>(e)) {
+        if (member->isArrow()) break;
+        fields = "." + member->getMemberDecl()->getNameAsString() + fields;
+        e = member->getBase()->IgnoreParenImpCasts();
+    }
+
+    const Expr *base = nullptr;
+    if (const auto *subscript = llvm::dyn_cast<ArraySubscriptExpr>(e)) {
+        base = subscript->getBase()->IgnoreParenImpCasts();
+        access.index = subscript->getIdx();
+    } else if (const auto *subscript = llvm::dyn_cast<CXXOperatorCallExpr>(e)) {
+        if (!isContainerSubscript(subscript)) {
+            body.reason = "it calls " + getText(subscript, body.RW);
+            return;
+        }
+        base = subscript->getArg(0)->IgnoreParenImpCasts();
+        access.index = subscript->getArg(1);
+    }
+
+    if (base) {
+        collectExpr(access.index, body);
+        if (const VarDecl *var = asVariable(base)) {
+            if (body.locals.count(var)) return;
+        } else {
+            collectExpr(base, body);
+        }
+
+        access.base = getText(base, body.RW);
+        access.baseExpr = base;
+        access.key = access.base + "[]" + fields;
+    } else {
+        if (const auto *ref = llvm::dyn_cast<DeclRefExpr>(e)) {
+            const auto *var = llvm::dyn_cast<VarDecl>(ref->getDecl());
+            if (!var) return;
+
+            if (var == body.loopVar) {
+                if (kind != AccessKind::Read) body.reason = "the loop variable is modified in the body";
+                return;
+            }
+            if (body.locals.count(var)) return;
+
+            if (e == lvalue) access.variable = var;
+        } else {
+            for (const Stmt *Child : e->children()) {
+                if (const auto *childExpr = llvm::dyn_cast_or_null<Expr>(Child)) collectExpr(childExpr, body);
+            }
+        }
+
+        access.key = getText(lvalue, body.RW);
+    }
+
+    body.accesses.push_back(access);
+}
+
+static void
+collectExpr(const Expr *e, LoopBody &body) {
+    if (!e || !body.reason.empty()) return;
+    e = e->IgnoreParens();
+
+    if (e->isInstantiationDependent()) {
+        body.reason = "it depends on template parameters";
+        return;
+    }
+
+    if (llvm::isa<CXXNewExpr>(e) || llvm::isa<CXXDeleteExpr>(e)) {
+        body.reason = "it allocates memory";
+        return;
+    }
+    if (llvm::isa<CXXThrowExpr>(e)) {
+        body.reason = "it throws";
+        return;
+    }
+    if (llvm::isa<LambdaExpr>(e) || llvm::isa<StmtExpr>(e)) {
+        body.reason = "it contains a nested body";
+        return;
+    }
+    if (const auto *construct = llvm::dyn_cast<CXXConstructExpr>(e)) {
+        if (!construct->getConstructor()->isTrivial()) {
+            body.reason = "it calls " + construct->getConstructor()->getQualifiedNameAsString();
+            return;
+        }
+    }
+
+    if (const auto *op = llvm::dyn_cast<BinaryOperator>(e)) {
+        if (op->getOpcode() == BO_Assign) {
+            addAccess(op->getLHS(), AccessKind::Write, "", body);
+            collectExpr(op->getRHS(), body);
+            return;
+        }
+        if (op->isCompoundAssignmentOp()) {
+            std::string reduction;
+            if (op->getOpcode() == BO_AddAssign || op->getOpcode() == BO_SubAssign) reduction = "+";
+            if (op->getOpcode() == BO_MulAssign) reduction = "*";
+
+            addAccess(op->getLHS(), AccessKind::Update, reduction, body);
+            collectExpr(op->getRHS(), body);
+            return;
+        }
+    }
+
+    if (const auto *op = llvm::dyn_cast<UnaryOperator>(e)) {
+        if (op->isIncrementDecrementOp() || op->getOpcode() == UO_AddrOf) {
+            addAccess(op->getSubExpr(), AccessKind::Write, "", body);
+            return;
+        }
+        if (op->getOpcode() == UO_Deref) {
+            addAccess(op, AccessKind::Read, "", body);
+            return;
+        }
+    }
+
+    if (const auto *op = llvm::dyn_cast<CXXOperatorCallExpr>(e)) {
+        if (isContainerSubscript(op)) {
+            addAccess(op, AccessKind::Read, "", body);
+            return;
+        }
+    }
+
+    if (const auto *call = llvm::dyn_cast<CallExpr>(e)) {
+        const FunctionDecl *callee = call->getDirectCallee();
+        bool math = callee && !llvm::isa<CXXMethodDecl>(callee) && callee->getIdentifier()
+            && SIMD_MATH_FUNCTIONS.count(callee->getName().str())
+            && (callee->isInStdNamespace() || callee->getDeclContext()->getRedeclContext()->isTranslationUnit());
+
+        if (!math) {
+            body.reason = "it calls " + (callee ? callee->getQualifiedNameAsString() : getText(call->getCallee(), body.RW));
+            return;
+        }
+
+        for (const Expr *arg : call->arguments()) collectExpr(arg, body);
+        return;
+    }
+
+    if (llvm::isa<DeclRefExpr>(e) || llvm::isa<MemberExpr>(e) || llvm::isa<ArraySubscriptExpr>(e)) {
+        addAccess(e, AccessKind::Read, "", body);
+        return;
+    }
+
+    for (const Stmt *Child : e->children()) {
+        if (const auto *childExpr = llvm::dyn_cast_or_null<Expr>(Child)) collectExpr(childExpr, body);
+    }
+}
+
+/* a reference to an existing object, rather than to a temporary it extends */
+static bool
+isBoundToObject(const VarDecl *var) {
+    if (!var->getType()->isReferenceType() || !var->hasInit()) return false;
+
+    const Expr *init = var->getInit();
+    if (const auto *cleanups = llvm::dyn_cast<ExprWithCleanups>(init)) init = cleanups->getSubExpr();
+    return !llvm::isa<MaterializeTemporaryExpr>(init);
+}
+
+static void
+collectStmt(const Stmt *s, LoopBody &body) {
+    if (!s || !body.reason.empty()) return;
+
+    if (llvm::isa<BreakStmt>(s) || llvm::isa<ReturnStmt>(s) || llvm::isa<GotoStmt>(s) || llvm::isa<IndirectGotoStmt>(s)) {
+        body.reason = "it leaves the loop early";
+        return;
+    }
+    if (llvm::isa<AsmStmt>(s) || llvm::isa<CXXTryStmt>(s) || llvm::isa<CoreturnStmt>(s)) {
+        body.reason = "it contains an unsupported statement";
+        return;
+    }
+
+    if (const auto *decl = llvm::dyn_cast<DeclStmt>(s)) {
+        for (const Decl *d : decl->decls()) {
+            if (const auto *var = llvm::dyn_cast<VarDecl>(d)) {
+                if (var->isStaticLocal()) {
+                    body.reason = "it declares the static variable " + var->getNameAsString();
+                    return;
+                }
+                if (isBoundToObject(var)) {
+                    /* uses of the reference are not followed, the binding stands for them */
+                    QualType referenced = var->getType().getNonReferenceType();
+                    if (!referenced->isScalarType()) {
+                        body.reason = "it declares " + var->getNameAsString() + ", a reference to a non-scalar";
+                        return;
+                    }
+                    addAccess(var->getInit(), referenced.isConstQualified() ? AccessKind::Read : AccessKind::Write, "", body);
+                } else if (var->hasInit()) {
+                    collectExpr(var->getInit(), body);
+                }
+                body.locals.insert(var);
+            }
+        }
+        return;
+    }
+
+    if (const auto *e = llvm::dyn_cast<Expr>(s)) {
+        collectExpr(e, body);
+        return;
+    }
+
+    for (const Stmt *Child : s->children()) {
+        collectStmt(Child, body);
+    }
+}
+
+/* index `coef * i + offset` in the loop variable i */
+static bool
+getAffine(const Expr *e, const VarDecl *loopVar, ASTContext &AC, long long &coef, long long &offset) {
+    e = e->IgnoreParenImpCasts();
+    Expr::EvalResult result;
+
+    if (asVariable(e) == loopVar) {
+        coef = 1;
+        offset = 0;
+        return true;
+    }
+    if (e->EvaluateAsInt(result, AC)) {
+        coef = 0;
+        offset = result.Val.getInt().getSExtValue();
+        return true;
+    }
+
+    const auto *op = llvm::dyn_cast<BinaryOperator>(e);
+    long long lcoef, loffset, rcoef, roffset;
+    if (!op || !getAffine(op->getLHS(), loopVar, AC, lcoef, loffset) || !getAffine(op->getRHS(), loopVar, AC, rcoef, roffset)) {
+        return false;
+    }
+
+    switch (op->getOpcode()) {
+    case BO_Add:
+        coef = lcoef + rcoef;
+        offset = loffset + roffset;
+        return true;
+    case BO_Sub:
+        coef = lcoef - rcoef;
+        offset = loffset - roffset;
+        return true;
+    case BO_Mul:
+        if (lcoef && rcoef) return false;
+        coef = lcoef * roffset + rcoef * loffset;
+        offset = loffset * roffset;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* accesses to one key that all accumulate with the same operator into one location */
+static bool
+isReduction(const std::vector<const Access *> &group, const Rewriter &RW) {
+    const Access *first = group.front();
+    if (first->op.empty() || !first->lvalue->getType()->isArithmeticType()) return false;
+
+    for (const Access *access : group) {
+        if (access->kind != AccessKind::Update || access->op != first->op) return false;
+        if (first->index && getText(access->index, RW) != getText(first->index, RW)) return false;
+    }
+
+    return true;
+}
+
+static std::string
+getCarriedReason(const std::vector<const Access *> &group, const std::string &what) {
+    bool accumulated = false;
+    bool read = false;
+    for (const Access *access : group) {
+        accumulated |= access->kind == AccessKind::Update && !access->op.empty();
+        read |= access->kind == AccessKind::Read;
+    }
+
+    if (accumulated && read) {
+        return what + " is accumulated and read in the same loop";
+    }
+    return what + " is carried from one iteration to the next";
+}
+
+bool
+isInnermostLoop(const ForStmt *loop) {
+    std::vector<const Stmt *> stack = {loop->getBody()};
+
+    while (!stack.empty()) {
+        const Stmt *s = stack.back();
+        stack.pop_back();
+        if (!s) continue;
+
+        if (llvm::isa<ForStmt>(s) || llvm::isa<WhileStmt>(s) || llvm::isa<DoStmt>(s) || llvm::isa<CXXForRangeStmt>(s)) {
+            return false;
+        }
+        for (const Stmt *Child : s->children()) stack.push_back(Child);
+    }
+
+    return true;
+}
+
+/* location right after the loop body */
+SourceLocation
+getLoopEnd(const ForStmt *loop, ASTContext &AC) {
+    const Stmt *body = loop->getBody();
+    if (llvm::isa<CompoundStmt>(body)) {
+        return body->getEndLoc().getLocWithOffset(1);
+    }
+    return Lexer::findLocationAfterToken(body->getEndLoc(), tok::semi, AC.getSourceManager(), AC.getLangOpts(), false);
+}
+
+/*
+a loop can be vectorized when no element it writes is accessed by another iteration closer than the
+vector length, and every scalar it writes is either private to an iteration or a reduction. Distinct
+arrays are assumed not to overlap, which is reported along with the loop
+*/
+SimdLoop
+analyzeSimdLoop(const ForStmt *loop, ASTContext &AC, const Rewriter &RW) {
+    SimdLoop simd;
+    long long step = 0;
+
+    const VarDecl *loopVar = getLoopVariable(loop, AC, step);
+    if (!loopVar) {
+        simd.reason = "it is not in canonical form";
+        return simd;
+    }
+
+    LoopBody body{loopVar, AC, RW, {}, {}, ""};
+    collectStmt(loop->getBody(), body);
+    if (!body.reason.empty()) {
+        simd.reason = body.reason;
+        return simd;
+    }
+
+    std::map<std::string, std::vector<const Access *>> keys;
+    std::set<const VarDecl *> written;
+    for (const Access &access : body.accesses) {
+        keys[access.key].push_back(&access);
+        if (access.kind != AccessKind::Read && access.variable) written.insert(access.variable);
+    }
+
+    if (referencesAny(loop->getCond(), written)) {
+        simd.reason = "its bound is modified in the body";
+        return simd;
+    }
+
+    /* anything an index may depend on besides the loop variable and invariants */
+    std::set<const VarDecl *> varying = written;
+    varying.insert(body.locals.begin(), body.locals.end());
+
+    std::set<std::string> memory;
+    std::set<std::string> aligned;
+    bool writesMemory = false;
+    long long distance = 0;
+
+    for (const auto &[key, group] : keys) {
+        const Access *first = group.front();
+        bool isWritten = false;
+        for (const Access *access : group) isWritten |= access->kind != AccessKind::Read;
+
+        if (first->index || !first->variable) {
+            memory.insert(first->index ? first->base : key);
+            writesMemory |= isWritten;
+        }
+
+        if (first->baseExpr) {
+            if (const VarDecl *array = asVariable(first->baseExpr)) {
+                if (const auto *type = AC.getAsConstantArrayType(array->getType())) {
+                    long long alignment = AC.getDeclAlign(array).getQuantity();
+                    if (alignment >= 16 && alignment > AC.getTypeAlignInChars(type->getElementType()).getQuantity()) {
+                        aligned.insert(array->getNameAsString() + ": " + std::to_string(alignment));
+                    }
+                }
+            }
+        }
+
+        if (!isWritten) continue;
+
+        if (!first->index) {
+            if (!isReduction(group, RW)) {
+                simd.reason = getCarriedReason(group, key);
+                return simd;
+            }
+
+            SimdReduction reduction;
+            reduction.op = first->op;
+            reduction.target = first->variable ? first->variable->getNameAsString() : key;
+            reduction.type = first->lvalue->getType().getUnqualifiedType().getAsString(AC.getPrintingPolicy());
+            reduction.variable = first->variable != nullptr;
+            for (const Access *access : group) reduction.updates.push_back(access->lvalue);
+            simd.reductions.push_back(reduction);
+            continue;
+        }
+
+        std::set<const VarDecl *> loopAndVarying = varying;
+        loopAndVarying.insert(loopVar);
+        if (referencesAny(first->baseExpr, loopAndVarying)) {
+            simd.reason = first->base + " is written through a varying array";
+            return simd;
+        }
+
+        long long coef = 0;
+        bool invariant = false;
+        bool uniform = true;
+        std::vector<long long> offsets;
+
+        for (const Access *access : group) {
+            long long accessCoef, accessOffset;
+            if (referencesAny(access->index, varying) || !getAffine(access->index, loopVar, AC, accessCoef, accessOffset)) {
+                if (!referencesAny(access->index, loopAndVarying)) {
+                    invariant = true;
+                    offsets.push_back(0);
+                    continue;
+                }
+                simd.reason = key + " is accessed through a non-affine index";
+                return simd;
+            }
+
+            invariant |= accessCoef == 0;
+            uniform &= access == first || accessCoef == coef;
+            coef = accessCoef;
+            offsets.push_back(accessOffset);
+        }
+
+        if (invariant) {
+            if (!isReduction(group, RW)) {
+                simd.reason = getCarriedReason(group, getText(first->lvalue, RW));
+                return simd;
+            }
+
+            SimdReduction reduction;
+            reduction.op = first->op;
+            reduction.target = getText(first->lvalue, RW);
+            reduction.type = first->lvalue->getType().getUnqualifiedType().getAsString(AC.getPrintingPolicy());
+            for (const Access *access : group) reduction.updates.push_back(access->lvalue);
+            simd.reductions.push_back(reduction);
+            continue;
+        }
+
+        if (!uniform) {
+            simd.reason = key + " is accessed with different strides";
+            return simd;
+        }
+
+        /* dependence distance, in iterations, between a write and any other access to the same key */
+        long long stride = coef * step < 0 ? -coef * step : coef * step;
+        for (size_t i = 0; i < group.size(); ++i) {
+            if (group[i]->kind == AccessKind::Read) continue;
+
+            for (size_t j = 0; j < group.size(); ++j) {
+                long long gap = offsets[i] > offsets[j] ? offsets[i] - offsets[j] : offsets[j] - offsets[i];
+                if (gap == 0 || gap % stride != 0) continue;
+
+                if (gap / stride == 1) {
+                    simd.reason = key + " depends on the previous iteration";
+                    return simd;
+                }
+                distance = distance == 0 || gap / stride < distance ? gap / stride : distance;
+            }
+        }
+    }
+
+    if (writesMemory && memory.size() > 1) {
+        std::string names;
+        for (const std::string &name : memory) names += (names.empty() ? "" : ", ") + name;
+        simd.assumptions.push_back("assuming " + names + " do not overlap");
+    }
+
+    simd.legal = true;
+    simd.safelen = distance;
+    simd.aligned.assign(aligned.begin(), aligned.end());
+
+    return simd;
+}
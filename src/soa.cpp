@@ -0,0 +1,326 @@
+#include <soa.hpp>
+#include <concepts.hpp>
+
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/AST/ParentMapContext.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/AST/StmtCXX.h>
+#include <clang/Lex/Lexer.h>
+#include <llvm-18/llvm/Support/Casting.h>
+#include <llvm-18/llvm/Support/raw_ostream.h>
+#include <map>
+#include <set>
+#include <utility>
+
+/* container methods provided by the generated structures of arrays */
+static const std::set<std::string> SOA_METHODS = {
+    "size", "empty", "push_back", "pop_back", "back", "clear", "reserve", "resize"
+};
+
+class ContainerCollector : public RecursiveASTVisitor<ContainerCollector> {
+public:
+    explicit ContainerCollector(ASTContext &AC) : AC(AC) {}
+
+    bool VisitFieldDecl(FieldDecl *FD) {
+        QualType element;
+        if (AC.getSourceManager().isInMainFile(FD->getLocation()) && isStdVector(FD->getType(), element)) {
+            if (const CXXRecordDecl *record = element->getAsCXXRecordDecl()) {
+                containers.push_back({FD, record});
+            }
+        }
+        return true;
+    }
+
+    bool VisitMemberExpr(MemberExpr *ME) {
+        if (const auto *FD = llvm::dyn_cast<FieldDecl>(ME->getMemberDecl())) {
+            uses[FD].push_back(ME);
+        }
+        return true;
+    }
+
+    std::vector<std::pair<const FieldDecl *, const CXXRecordDecl *>> containers;
+    std::map<const FieldDecl *, std::vector<const MemberExpr *>> uses;
+
+private:
+    ASTContext &AC;
+};
+
+/* parent expression, looking through parentheses and, if asked, implicit casts */
+static const Stmt *
+getParentStmt(const Stmt *s, ASTContext &AC, bool skipCasts) {
+    while (s) {
+        auto parents = AC.getParentMapContext().getParents(*s);
+        if (parents.empty()) return nullptr;
+
+        const Stmt *parent = parents[0].get<Stmt>();
+        if (!parent || !(llvm::isa<ParenExpr>(parent) || (skipCasts && llvm::isa<ImplicitCastExpr>(parent)))) {
+            return parent;
+        }
+        s = parent;
+    }
+    return nullptr;
+}
+
+static bool
+isInLoop(const Stmt *s, ASTContext &AC) {
+    while (s) {
+        auto parents = AC.getParentMapContext().getParents(*s);
+        if (parents.empty()) return false;
+
+        s = parents[0].get<Stmt>();
+        if (llvm::isa_and_nonnull<ForStmt>(s) || llvm::isa_and_nonnull<WhileStmt>(s)
+            || llvm::isa_and_nonnull<DoStmt>(s) || llvm::isa_and_nonnull<CXXForRangeStmt>(s)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* `c[i].field` inside a loop */
+static bool
+isFieldAccessInLoop(const MemberExpr *use, ASTContext &AC) {
+    const auto *op = llvm::dyn_cast_or_null<CXXOperatorCallExpr>(getParentStmt(use, AC, true));
+    if (!op || op->getOperator() != OO_Subscript) return false;
+
+    const auto *member = llvm::dyn_cast_or_null<MemberExpr>(getParentStmt(op, AC, false));
+    return member && llvm::isa<FieldDecl>(member->getMemberDecl()) && isInLoop(op, AC);
+}
+
+static std::string
+checkRecord(const CXXRecordDecl *record, ASTContext &AC) {
+    std::string name = record->getNameAsString();
+    record = record->getDefinition();
+
+    if (!record || !AC.getSourceManager().isInMainFile(record->getLocation())) return name + " is not defined in this file";
+    if (!record->getDeclContext()->getRedeclContext()->isFileContext()) return name + " is not declared at namespace scope";
+    if (record->isUnion() || record->getNumBases() > 0 || record->isPolymorphic()) return name + " is not a plain struct";
+    if (!record->hasDefaultConstructor()) return name + " has no default constructor";
+    if (record->field_empty()) return name + " has no fields";
+
+    for (const FieldDecl *field : record->fields()) {
+        std::string fieldName = field->getNameAsString();
+
+        if (!field->getType()->isArithmeticType() || field->getType().isConstQualified() || field->isBitField()) {
+            return name + "::" + fieldName + " is not a plain number";
+        }
+        if (field->getAccess() == AS_private || field->getAccess() == AS_protected) {
+            return name + "::" + fieldName + " is not public";
+        }
+        if (SOA_METHODS.count(fieldName) || fieldName == "reference" || fieldName == "const_reference") {
+            return name + "::" + fieldName + " is named like a container member";
+        }
+    }
+
+    return "";
+}
+
+static std::string
+checkDeclaration(const FieldDecl *field) {
+    const CXXRecordDecl *parent = llvm::cast<CXXRecordDecl>(field->getParent());
+
+    if (parent->isDependentContext()) return "it belongs to a class template";
+    if (field->hasInClassInitializer()) return "it has a default member initializer";
+
+    /* the type is written once for all the members of a declaration */
+    for (const FieldDecl *other : parent->fields()) {
+        if (other != field && other->getTypeSpecStartLoc() == field->getTypeSpecStartLoc()) {
+            return "it is declared along with " + other->getNameAsString();
+        }
+    }
+
+    for (const CXXConstructorDecl *ctor : parent->ctors()) {
+        const auto *definition = llvm::dyn_cast_or_null<CXXConstructorDecl>(ctor->getDefinition());
+        if (!definition) continue;
+
+        for (const CXXCtorInitializer *init : definition->inits()) {
+            if (!init->isWritten() || init->getMember() != field) continue;
+
+            const auto *construct = llvm::dyn_cast<CXXConstructExpr>(init->getInit()->IgnoreImplicit());
+            if (!construct || construct->getNumArgs() > 0) return "it is initialized with arguments";
+        }
+    }
+
+    return "";
+}
+
+/* an element, `c[i]` or `c.back()`, becomes a proxy of references into the arrays */
+static std::string
+checkElementUse(const Expr *element, ASTContext &AC) {
+    const Stmt *parent = getParentStmt(element, AC, false);
+
+    if (const auto *member = llvm::dyn_cast_or_null<MemberExpr>(parent)) {
+        if (llvm::isa<FieldDecl>(member->getMemberDecl())) return "";
+        return "an element calls " + member->getMemberDecl()->getNameAsString();
+    }
+
+    /* assigned as a whole */
+    if (const auto *op = llvm::dyn_cast_or_null<CXXOperatorCallExpr>(parent)) {
+        if (op->getOperator() == OO_Equal && op->getArg(0)->IgnoreParens() == element) return "";
+    }
+
+    /* copied as a whole, the proxy converts to a value; a const reference would see later writes, the value doesn't */
+    if (const auto *cast = llvm::dyn_cast_or_null<ImplicitCastExpr>(parent)) {
+        if (cast->getCastKind() == CK_NoOp && cast->getType().isConstQualified()) {
+            const auto *copy = llvm::dyn_cast_or_null<CXXConstructExpr>(getParentStmt(cast, AC, false));
+            if (!copy || !copy->getConstructor()->isCopyOrMoveConstructor()) return "an element is bound to a reference";
+
+            auto parents = AC.getParentMapContext().getParents(*copy);
+            if (parents.empty()) return "an element is bound to a reference";
+
+            /* auto would deduce the proxy, a reference to the element */
+            if (const auto *var = parents[0].get<VarDecl>()) {
+                if (var->getType()->getContainedDeducedType()) {
+                    return "an element initializes " + var->getNameAsString() + ", whose type is deduced";
+                }
+                return "";
+            }
+            if (const auto *call = parents[0].get<CallExpr>()) {
+                if (const FunctionDecl *task = getTaskCallee(call)) {
+                    return "an element is passed to " + task->getQualifiedNameAsString() + ", which may become a task";
+                }
+                return "";
+            }
+            if (parents[0].get<ReturnStmt>()) return "";
+            return "an element is copied into a temporary";
+        }
+    }
+
+    return "an element is used as an lvalue";
+}
+
+static std::string
+checkContainerUse(const MemberExpr *use, ASTContext &AC) {
+    const Stmt *parent = getParentStmt(use, AC, true);
+
+    if (const auto *op = llvm::dyn_cast_or_null<CXXOperatorCallExpr>(parent)) {
+        if (op->getOperator() == OO_Subscript && op->getArg(0)->IgnoreParenImpCasts() == use) {
+            return checkElementUse(op, AC);
+        }
+    }
+
+    if (const auto *method = llvm::dyn_cast_or_null<MemberExpr>(parent)) {
+        std::string name = method->getMemberDecl()->getNameAsString();
+        if (!SOA_METHODS.count(name)) return "it calls " + name;
+
+        const auto *call = llvm::dyn_cast_or_null<CXXMemberCallExpr>(getParentStmt(method, AC, false));
+        if (!call) return "it uses " + name + " without calling it";
+
+        return name == "back" ? checkElementUse(call, AC) : "";
+    }
+
+    return "it is used as a std::vector";
+}
+
+static std::string
+getSoAClass(const CXXRecordDecl *record, ASTContext &AC) {
+    std::string type = record->getNameAsString();
+    std::string arrays, references, constReferences, elements, toValue, assignValue, assignOther;
+    std::string pushBack, popBack, clear, reserve, resize;
+
+    for (const FieldDecl *field : record->fields()) {
+        std::string name = field->getNameAsString();
+        std::string fieldType = field->getType().getAsString(AC.getPrintingPolicy());
+
+        arrays += "    std::vector<" + fieldType + "> " + name + ";\n";
+        references += "        " + fieldType + " &" + name + ";\n";
+        constReferences += "        const " + fieldType + " &" + name + ";\n";
+        elements += (elements.empty() ? "" : ", ") + name + "[AUTOPAR_i]";
+        toValue += "            AUTOPAR_value." + name + " = " + name + ";\n";
+        assignValue += "            " + name + " = AUTOPAR_value." + name + ";\n";
+        assignOther += "            " + name + " = AUTOPAR_other." + name + ";\n";
+        pushBack += "        " + name + ".push_back(AUTOPAR_value." + name + ");\n";
+        popBack += "        " + name + ".pop_back();\n";
+        clear += "        " + name + ".clear();\n";
+        reserve += "        " + name + ".reserve(AUTOPAR_n);\n";
+        resize += "        " + name + ".resize(AUTOPAR_n, AUTOPAR_value." + name + ");\n";
+    }
+
+    std::string first = record->field_begin()->getNameAsString();
+    std::string conversion = "        operator " + type + "() const {\n"
+        "            " + type + " AUTOPAR_value{};\n" + toValue + "            return AUTOPAR_value;\n        }\n";
+
+    return "\n\n/* structure of arrays of " + type + ", generated by autopar --soa */\n"
+        "struct AUTOPAR_SoA_" + type + " {\n"
+        "    struct const_reference {\n" + constReferences + "\n" + conversion + "    };\n\n"
+        "    struct reference {\n" + references + "\n" + conversion + "\n"
+        "        reference &operator=(const " + type + " &AUTOPAR_value) {\n" + assignValue + "            return *this;\n        }\n\n"
+        "        reference &operator=(const reference &AUTOPAR_other) {\n" + assignOther + "            return *this;\n        }\n\n"
+        "        reference &operator=(const const_reference &AUTOPAR_other) {\n" + assignOther + "            return *this;\n        }\n"
+        "    };\n\n"
+        + arrays + "\n"
+        "    std::size_t size() const { return " + first + ".size(); }\n"
+        "    bool empty() const { return " + first + ".empty(); }\n\n"
+        "    reference operator[](std::size_t AUTOPAR_i) { return {" + elements + "}; }\n"
+        "    const_reference operator[](std::size_t AUTOPAR_i) const { return {" + elements + "}; }\n"
+        "    reference back() { return (*this)[size() - 1]; }\n"
+        "    const_reference back() const { return (*this)[size() - 1]; }\n\n"
+        "    void push_back(const " + type + " &AUTOPAR_value) {\n" + pushBack + "    }\n\n"
+        "    void pop_back() {\n" + popBack + "    }\n\n"
+        "    void clear() {\n" + clear + "    }\n\n"
+        "    void reserve(std::size_t AUTOPAR_n) {\n" + reserve + "    }\n\n"
+        "    void resize(std::size_t AUTOPAR_n, const " + type + " &AUTOPAR_value = " + type + "{}) {\n" + resize + "    }\n"
+        "};";
+}
+
+/*
+the generated container keeps the interface of std::vector used by the program, and its elements are
+proxies of references into the arrays, so that `c[i].x` still compiles and only touches the array of x.
+A member is only converted when every use in this TU is one the proxy supports, and other members are
+reported with the first use that prevents it
+*/
+void
+convertToSoA(ASTContext &AC, Rewriter &RW) {
+    ContainerCollector collector(AC);
+    collector.TraverseDecl(AC.getTranslationUnitDecl());
+
+    SourceManager &SM = AC.getSourceManager();
+    std::set<const CXXRecordDecl *> emitted;
+
+    for (const auto &[field, element] : collector.containers) {
+        const std::vector<const MemberExpr *> &uses = collector.uses[field];
+
+        bool hot = false;
+        for (const MemberExpr *use : uses) {
+            hot |= isFieldAccessInLoop(use, AC);
+        }
+        if (!hot) continue;
+
+        const CXXRecordDecl *record = element->getDefinition();
+        std::string name = field->getQualifiedNameAsString();
+        std::string reason = checkRecord(element, AC);
+
+        if (reason.empty()) {
+            reason = checkDeclaration(field);
+        }
+        for (const MemberExpr *use : uses) {
+            if (!reason.empty()) break;
+
+            reason = checkContainerUse(use, AC);
+            if (!reason.empty()) {
+                reason += " at line " + std::to_string(SM.getPresumedLineNumber(use->getBeginLoc()));
+            }
+        }
+
+        SourceLocation end;
+        if (reason.empty()) {
+            end = Lexer::findLocationAfterToken(record->getBraceRange().getEnd(), tok::semi, SM, AC.getLangOpts(), false);
+            if (end.isInvalid()) reason = record->getNameAsString() + " is declared along with variables";
+        }
+
+        if (!reason.empty()) {
+            llvm::outs() << "SoA: cannot convert " << name << ": " << reason << "\n";
+            continue;
+        }
+
+        std::string qualified = record->getQualifiedNameAsString();
+        std::string scope = qualified.substr(0, qualified.size() - record->getNameAsString().size());
+
+        if (emitted.insert(record).second) {
+            RW.InsertText(end, getSoAClass(record, AC), true, true);
+        }
+        RW.ReplaceText(field->getTypeSourceInfo()->getTypeLoc().getSourceRange(), scope + "AUTOPAR_SoA_" + record->getNameAsString());
+
+        llvm::outs() << "SoA: converted " << name << " (" << record->getNameAsString() << ")\n";
+    }
+}
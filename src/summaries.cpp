@@ -0,0 +1,534 @@
+#include <summaries.hpp>
+
+#include <clang/AST/Expr.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/AST/ParentMapContext.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/AST/Stmt.h>
+#include <clang/AST/StmtCXX.h>
+#include <clang/Index/USRGeneration.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <set>
+
+#define LOOP_COST_FACTOR 16
+#define UNKNOWN_CALL_COST 16
+#define MAX_CALL_DEPTH 3
+#define MAX_COST 1000000000ULL
+
+/*
+What an expression referring to a parameter denotes while walking up its parents:
+memory that belongs to the caller, the parameter's own storage, or a pointer into caller memory.
+*/
+enum class Ref {
+    Object,
+    Local,
+    Pointer
+};
+
+static bool
+isWritablePointer(QualType type) {
+    return type->isPointerType() && !type->getPointeeType().isConstQualified();
+}
+
+static bool
+isWritableReference(QualType type) {
+    return type->isReferenceType() && !type.getNonReferenceType().isConstQualified();
+}
+
+/* whether binding `ref` to something of type `type` lets the caller memory be modified through it */
+static bool
+escapesTo(QualType type, Ref ref) {
+    if (ref == Ref::Object) return isWritableReference(type);
+    if (ref == Ref::Pointer) return isWritablePointer(type) || isWritableReference(type);
+    return false;
+}
+
+static bool
+argumentMayBeWritten(const FunctionDecl *callee, unsigned paramIdx, Ref ref) {
+    if (!callee || paramIdx >= callee->getNumParams()) return ref != Ref::Local;
+    return escapesTo(callee->getParamDecl(paramIdx)->getType(), ref);
+}
+
+/* conservative: true unless every path from `use` up to its full expression only reads the caller memory */
+static bool
+mayWriteCallerMemory(const Expr *use, Ref ref, const FunctionDecl *FD, ASTContext &AC) {
+    const Expr *curr = use;
+
+    while (true) {
+        auto parents = AC.getParents(*curr);
+        if (parents.empty()) return false;
+
+        if (const auto *VD = parents[0].get<VarDecl>()) {
+            return escapesTo(VD->getType(), ref);
+        }
+
+        if (parents[0].get<ReturnStmt>()) {
+            return escapesTo(FD->getReturnType(), ref);
+        }
+
+        const auto *parent = parents[0].get<Expr>();
+        if (!parent) return false;
+
+        if (const auto *cast = llvm::dyn_cast<CastExpr>(parent)) {
+            switch (cast->getCastKind()) {
+            case CK_LValueToRValue:
+                if (!isWritablePointer(cast->getType())) return false;
+                ref = Ref::Pointer;
+                break;
+            case CK_ArrayToPointerDecay:
+                if (ref == Ref::Object) ref = Ref::Pointer;
+                break;
+            case CK_NoOp:
+            case CK_BitCast:
+            case CK_DerivedToBase:
+            case CK_UncheckedDerivedToBase:
+            case CK_BaseToDerived:
+            case CK_Dynamic:
+                break;
+            default:
+                if (!llvm::isa<ExplicitCastExpr>(cast)) return false;
+                break;
+            }
+        } else if (const auto *unary = llvm::dyn_cast<UnaryOperator>(parent)) {
+            switch (unary->getOpcode()) {
+            case UO_Deref:
+                if (ref != Ref::Pointer) return false;
+                ref = Ref::Object;
+                break;
+            case UO_AddrOf:
+                if (ref == Ref::Local) return true; /* the pointer itself escapes */
+                ref = Ref::Pointer;
+                break;
+            case UO_PreInc:
+            case UO_PreDec:
+            case UO_PostInc:
+            case UO_PostDec:
+                return ref == Ref::Object;
+            case UO_Extension:
+                break;
+            default:
+                return false;
+            }
+        } else if (const auto *subscript = llvm::dyn_cast<ArraySubscriptExpr>(parent)) {
+            if (subscript->getBase() != curr || ref == Ref::Local) return false;
+            ref = Ref::Object;
+        } else if (const auto *member = llvm::dyn_cast<MemberExpr>(parent)) {
+            if (member->isArrow() ? ref != Ref::Pointer : ref != Ref::Object) return false;
+            if (const auto *method = llvm::dyn_cast<CXXMethodDecl>(member->getMemberDecl())) {
+                return !method->isConst() && !method->isStatic();
+            }
+            ref = Ref::Object;
+        } else if (const auto *binary = llvm::dyn_cast<BinaryOperator>(parent)) {
+            if (binary->isAssignmentOp()) {
+                if (binary->getLHS() == curr) return ref == Ref::Object;
+                return ref == Ref::Pointer;
+            }
+            if (binary->getOpcode() == BO_Comma) {
+                if (binary->getRHS() != curr) return false;
+            } else if (!(binary->isAdditiveOp() && ref == Ref::Pointer)) {
+                return false;
+            }
+        } else if (const auto *conditional = llvm::dyn_cast<AbstractConditionalOperator>(parent)) {
+            if (conditional->getCond() == curr) return false;
+        } else if (const auto *call = llvm::dyn_cast<CallExpr>(parent)) {
+            const FunctionDecl *callee = call->getDirectCallee();
+            unsigned offset = 0;
+
+            if (llvm::isa<CXXOperatorCallExpr>(call) && callee && llvm::isa<CXXMethodDecl>(callee)
+                && !llvm::cast<CXXMethodDecl>(callee)->isStatic()) {
+                if (call->getArg(0) == curr) {
+                    return ref != Ref::Local && !llvm::cast<CXXMethodDecl>(callee)->isConst();
+                }
+                offset = 1;
+            }
+
+            for (unsigned i = offset; i < call->getNumArgs(); ++i) {
+                if (call->getArg(i) == curr) {
+                    return argumentMayBeWritten(callee, i - offset, ref);
+                }
+            }
+
+            return false; /* called, not passed */
+        } else if (const auto *construct = llvm::dyn_cast<CXXConstructExpr>(parent)) {
+            for (unsigned i = 0; i < construct->getNumArgs(); ++i) {
+                if (construct->getArg(i) == curr) {
+                    return argumentMayBeWritten(construct->getConstructor(), i, ref);
+                }
+            }
+            return false;
+        } else if (llvm::isa<InitListExpr>(parent)) {
+            return ref == Ref::Pointer;
+        } else if (!(llvm::isa<ParenExpr>(parent) || llvm::isa<MaterializeTemporaryExpr>(parent)
+                     || llvm::isa<FullExpr>(parent) || llvm::isa<CXXBindTemporaryExpr>(parent))) {
+            return ref != Ref::Local;
+        }
+
+        curr = parent;
+    }
+}
+
+class ParamUseCollector : public RecursiveASTVisitor<ParamUseCollector> {
+public:
+    ParamUseCollector(const ParmVarDecl *param) : param(param) {}
+
+    bool VisitDeclRefExpr(DeclRefExpr *ref) {
+        if (ref->getDecl() == param) {
+            uses.push_back(ref);
+        }
+        return true;
+    }
+
+    const ParmVarDecl *param;
+    std::vector<const DeclRefExpr *> uses;
+};
+
+static ParamEffect
+getParamEffect(const FunctionDecl *FD, const ParmVarDecl *param, ASTContext &AC) {
+    const QualType type = param->getType();
+
+    if (!isWritablePointer(type) && !isWritableReference(type)) {
+        return ParamEffect::Read;
+    }
+
+    if (!FD->hasBody()) {
+        return ParamEffect::Write;
+    }
+
+    ParamUseCollector collector(param);
+    collector.TraverseStmt(FD->getBody());
+
+    if (collector.uses.empty()) {
+        return ParamEffect::None;
+    }
+
+    Ref ref = type->isReferenceType() ? Ref::Object : Ref::Local;
+    for (const auto *use : collector.uses) {
+        if (mayWriteCallerMemory(use, ref, FD, AC)) {
+            return ParamEffect::Write;
+        }
+    }
+
+    return ParamEffect::Read;
+}
+
+bool
+isPureLibraryFunction(const FunctionDecl *FD, ASTContext &AC) {
+    static const llvm::StringSet<> pureNames = {
+        "sqrt", "cbrt", "pow", "exp", "exp2", "expm1", "log", "log2", "log10", "log1p",
+        "sin", "cos", "tan", "asin", "acos", "atan", "atan2", "sinh", "cosh", "tanh",
+        "fabs", "abs", "floor", "ceil", "round", "trunc", "fmod", "hypot", "fma",
+        "fmin", "fmax", "min", "max", "copysign"
+    };
+
+    if (!FD->getIdentifier()) return false;
+
+    llvm::StringRef name = FD->getName();
+    name.consume_front("__builtin_");
+
+    return pureNames.contains(name) && (FD->getBuiltinID() || AC.getSourceManager().isInSystemHeader(FD->getLocation()));
+}
+
+static bool isPure(const FunctionDecl *, ASTContext &, std::map<const FunctionDecl *, bool> &);
+
+class PurityChecker : public RecursiveASTVisitor<PurityChecker> {
+public:
+    PurityChecker(const FunctionDecl *FD, ASTContext &AC, std::map<const FunctionDecl *, bool> &cache)
+        : FD(FD), AC(AC), cache(cache) {}
+
+    bool pure = true;
+
+    bool VisitDeclRefExpr(DeclRefExpr *ref) {
+        if (const auto *VD = llvm::dyn_cast<VarDecl>(ref->getDecl())) {
+            if (VD->hasGlobalStorage() && !VD->getType().isConstQualified()) {
+                pure = false;
+            }
+        }
+        return pure;
+    }
+
+    bool VisitVarDecl(VarDecl *VD) {
+        if (VD->isStaticLocal()) pure = false;
+        return pure;
+    }
+
+    bool VisitCallExpr(CallExpr *call) {
+        const FunctionDecl *callee = call->getDirectCallee();
+
+        if (!callee) {
+            pure = false;
+        } else if (callee->getCanonicalDecl() == FD->getCanonicalDecl()) {
+            /* recursion does not change purity */
+        } else if (isPureLibraryFunction(callee, AC)) {
+            /* math functions */
+        } else if (callee->isInStdNamespace()) {
+            pure = false;
+        } else {
+            pure = isPure(callee, AC, cache);
+        }
+
+        return pure;
+    }
+
+    bool VisitCXXConstructExpr(CXXConstructExpr *construct) {
+        if (!construct->getConstructor()->isTrivial() && !construct->getConstructor()->isConstexpr()) {
+            pure = false;
+        }
+        return pure;
+    }
+
+    bool VisitCXXThisExpr(CXXThisExpr *) { pure = false; return false; }
+    bool VisitCXXNewExpr(CXXNewExpr *) { pure = false; return false; }
+    bool VisitCXXDeleteExpr(CXXDeleteExpr *) { pure = false; return false; }
+    bool VisitCXXThrowExpr(CXXThrowExpr *) { pure = false; return false; }
+    bool VisitAsmStmt(AsmStmt *) { pure = false; return false; }
+
+private:
+    const FunctionDecl *FD;
+    ASTContext &AC;
+    std::map<const FunctionDecl *, bool> &cache;
+};
+
+static bool
+isPure(const FunctionDecl *FD, ASTContext &AC, std::map<const FunctionDecl *, bool> &cache) {
+    FD = FD->getCanonicalDecl();
+
+    auto it = cache.find(FD);
+    if (it != cache.end()) return it->second;
+
+    const FunctionDecl *definition = nullptr;
+    if (!FD->hasBody(definition)) {
+        const FunctionSummary *summary = SummaryIndex::get().lookup(FD);
+        return cache[FD] = summary && summary->pure;
+    }
+
+    if (const auto *method = llvm::dyn_cast<CXXMethodDecl>(definition)) {
+        if (!method->isStatic()) return cache[FD] = false;
+    }
+
+    /* optimistic for recursive cycles, corrected below */
+    cache[FD] = true;
+
+    for (const auto *param : definition->parameters()) {
+        if (getParamEffect(definition, param, AC) == ParamEffect::Write) {
+            return cache[FD] = false;
+        }
+    }
+
+    PurityChecker checker(definition, AC, cache);
+    checker.TraverseStmt(definition->getBody());
+
+    return cache[FD] = checker.pure;
+}
+
+static unsigned long long
+costOf(const Stmt *s, ASTContext &AC, int depth, std::set<const FunctionDecl *> &visiting) {
+    if (!s) return 0;
+
+    unsigned long long cost = 1;
+
+    for (const Stmt *child : s->children()) {
+        cost += costOf(child, AC, depth, visiting);
+    }
+
+    if (llvm::isa<ForStmt>(s) || llvm::isa<WhileStmt>(s) || llvm::isa<DoStmt>(s) || llvm::isa<CXXForRangeStmt>(s)) {
+        cost *= LOOP_COST_FACTOR;
+    } else if (const auto *call = llvm::dyn_cast<CallExpr>(s)) {
+        const FunctionDecl *callee = call->getDirectCallee();
+        const FunctionDecl *definition = nullptr;
+
+        if (callee && callee->hasBody(definition) && depth < MAX_CALL_DEPTH && !visiting.count(definition)) {
+            visiting.insert(definition);
+            cost += costOf(definition->getBody(), AC, depth + 1, visiting);
+            visiting.erase(definition);
+        } else if (const FunctionSummary *summary = callee ? SummaryIndex::get().lookup(callee) : nullptr) {
+            cost += summary->cost;
+        } else {
+            cost += UNKNOWN_CALL_COST;
+        }
+    }
+
+    return std::min(cost, MAX_COST);
+}
+
+
+/* PUBLICS */
+
+
+SummaryIndex &SummaryIndex::get() {
+    static SummaryIndex index;
+    return index;
+}
+
+static const char *
+getEffectName(ParamEffect effect) {
+    switch (effect) {
+    case ParamEffect::None:
+        return "none";
+    case ParamEffect::Read:
+        return "read";
+    case ParamEffect::Write:
+        return "write";
+    }
+    return "write";
+}
+
+bool SummaryIndex::load(StringRef path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        llvm::errs() << "Error reading summary index " << path << ": " << buffer.getError().message() << "\n";
+        return false;
+    }
+
+    auto json = llvm::json::parse((*buffer)->getBuffer());
+    if (!json) {
+        llvm::errs() << "Error parsing summary index " << path << ": " << llvm::toString(json.takeError()) << "\n";
+        return false;
+    }
+
+    const llvm::json::Object *root = json->getAsObject();
+    const llvm::json::Array *functions = root ? root->getArray("functions") : nullptr;
+    if (!functions) {
+        llvm::errs() << "Error parsing summary index " << path << ": missing \"functions\"\n";
+        return false;
+    }
+
+    for (const auto &value : *functions) {
+        const llvm::json::Object *object = value.getAsObject();
+        if (!object) continue;
+
+        FunctionSummary summary;
+        summary.usr = object->getString("usr").value_or("").str();
+        summary.name = object->getString("name").value_or("").str();
+        summary.cost = object->getInteger("cost").value_or(0);
+        summary.pure = object->getBoolean("pure").value_or(false);
+
+        if (const llvm::json::Array *params = object->getArray("params")) {
+            for (const auto &param : *params) {
+                StringRef effect = param.getAsString().value_or("write");
+                summary.params.push_back(effect == "none" ? ParamEffect::None
+                                         : effect == "read" ? ParamEffect::Read
+                                         : ParamEffect::Write);
+            }
+        }
+
+        if (!summary.usr.empty()) {
+            add(std::move(summary));
+        }
+    }
+
+    return true;
+}
+
+bool SummaryIndex::save(StringRef path) const {
+    llvm::json::Array functions;
+
+    for (const auto &entry : summaries) {
+        const FunctionSummary &summary = entry.second;
+        llvm::json::Array params;
+        for (ParamEffect effect : summary.params) {
+            params.push_back(getEffectName(effect));
+        }
+
+        functions.push_back(llvm::json::Object{
+            {"usr", summary.usr},
+            {"name", summary.name},
+            {"params", std::move(params)},
+            {"cost", summary.cost},
+            {"pure", summary.pure},
+        });
+    }
+
+    std::error_code EC;
+    llvm::raw_fd_ostream outFile(path, EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+        llvm::errs() << "Error opening file for writing: " << path << "\n";
+        return false;
+    }
+
+    llvm::json::OStream J(outFile, 2);
+    J.value(llvm::json::Object{{"functions", std::move(functions)}});
+    outFile << "\n";
+
+    return true;
+}
+
+void SummaryIndex::add(FunctionSummary summary) {
+    std::string usr = summary.usr;
+    summaries[usr] = std::move(summary);
+}
+
+const FunctionSummary *SummaryIndex::lookup(const FunctionDecl *FD) const {
+    if (summaries.empty()) return nullptr;
+
+    auto it = summaries.find(getUSR(FD));
+    return it == summaries.end() ? nullptr : &it->second;
+}
+
+std::string
+getUSR(const Decl *D) {
+    llvm::SmallString<128> buffer;
+    if (index::generateUSRForDecl(D, buffer)) {
+        return "";
+    }
+    return std::string(buffer.str());
+}
+
+bool
+isPureFunction(const FunctionDecl *FD, ASTContext &AC) {
+    std::map<const FunctionDecl *, bool> cache;
+    return isPure(FD, AC, cache);
+}
+
+ParamEffect
+getParameterEffect(const FunctionDecl *FD, unsigned index, ASTContext &AC) {
+    const FunctionDecl *definition = nullptr;
+    if (!FD->hasBody(definition)) return ParamEffect::Write;
+
+    return getParamEffect(definition, definition->getParamDecl(index), AC);
+}
+
+/* whether `FD` touches no global state, whatever it does to its parameters */
+bool
+isPureBody(const FunctionDecl *FD, ASTContext &AC) {
+    const FunctionDecl *definition = nullptr;
+    if (!FD->hasBody(definition)) return false;
+
+    std::map<const FunctionDecl *, bool> cache;
+    PurityChecker checker(definition, AC, cache);
+    checker.TraverseStmt(definition->getBody());
+
+    return checker.pure;
+}
+
+unsigned
+estimateCost(const FunctionDecl *FD, ASTContext &AC) {
+    const FunctionDecl *definition = nullptr;
+    if (!FD->hasBody(definition)) {
+        const FunctionSummary *summary = SummaryIndex::get().lookup(FD);
+        return summary ? summary->cost : UNKNOWN_CALL_COST;
+    }
+
+    std::set<const FunctionDecl *> visiting = {definition};
+    return costOf(definition->getBody(), AC, 0, visiting);
+}
+
+FunctionSummary
+computeFunctionSummary(const FunctionDecl *FD, ASTContext &AC) {
+    FunctionSummary summary;
+
+    summary.usr = getUSR(FD);
+    summary.name = FD->getQualifiedNameAsString();
+    for (const auto *param : FD->parameters()) {
+        summary.params.push_back(getParamEffect(FD, param, AC));
+    }
+    summary.cost = estimateCost(FD, AC);
+    summary.pure = isPureFunction(FD, AC);
+
+    return summary;
+}
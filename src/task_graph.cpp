@@ -0,0 +1,299 @@
+#include <task_graph.hpp>
+#include <options.hpp>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+
+/* variables through which the task `later` waits for `earlier`, as with depend clauses */
+static std::string
+getConflicts(const DependInfo &earlier, const DependInfo &later) {
+    std::set<std::string> vars;
+
+    for (const auto &var : earlier.write) {
+        if (later.read.count(var) || later.write.count(var)) vars.insert(var);
+    }
+    for (const auto &var : earlier.read) {
+        if (later.write.count(var)) vars.insert(var);
+    }
+
+    std::string text;
+    for (const auto &var : vars) {
+        text += (text.empty() ? "" : ", ") + var;
+    }
+    return text;
+}
+
+static std::string
+getNodeName(const TaskGraph::Node &node) {
+    if (node.kind == TaskGraph::Node::End) return "end";
+    return node.label + " (line " + std::to_string(node.line) + ")";
+}
+
+static const char *
+getKindName(TaskGraph::Node::Kind kind) {
+    switch (kind) {
+        case TaskGraph::Node::Call: return "task";
+        case TaskGraph::Node::Wait: return "taskwait";
+        case TaskGraph::Node::End: return "end";
+    }
+    return "";
+}
+
+static std::string
+escape(const std::string &text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+/*
+every call site is one node costing the static estimate of its callee, whatever the number of times
+it runs, and the code of the function between the tasks is not counted. Tasks only wait for the earlier
+ones of their segment (the tasks between two barriers) they conflict with, and barriers wait for the
+whole segment before them
+*/
+TaskGraph
+buildTaskGraph(const Function &function) {
+    TaskGraph graph;
+    graph.function = function.name;
+
+    const std::vector<Task> &tasks = function.tasks;
+    const std::size_t nbTasks = tasks.size();
+    const std::size_t nbBarriers = function.barriers.size();
+    const int end = nbTasks + nbBarriers;
+
+    /* segment k ends with barrier k, the last one with the end of the taskgroup */
+    std::vector<std::size_t> segment(nbTasks);
+    for (std::size_t i = 0, k = 0; i < nbTasks; ++i) {
+        while (k < nbBarriers && function.barriers[k].tasksBefore <= i) ++k;
+        segment[i] = k;
+    }
+
+    for (const Task &task : tasks) {
+        graph.nodes.push_back({TaskGraph::Node::Call, task.callee, task.line, std::max(1u, task.cost)});
+    }
+    for (const Barrier &barrier : function.barriers) {
+        graph.nodes.push_back({TaskGraph::Node::Wait, "taskwait", barrier.line, 0});
+    }
+    graph.nodes.push_back({TaskGraph::Node::End, "end", 0, 0});
+
+    std::vector<bool> hasPred(nbTasks), hasSucc(nbTasks);
+    for (std::size_t j = 0; j < nbTasks; ++j) {
+        for (std::size_t i = 0; i < j; ++i) {
+            if (segment[i] != segment[j]) continue;
+
+            std::string vars = getConflicts(tasks[i].depInfo, tasks[j].depInfo);
+            if (vars.empty()) continue;
+
+            graph.edges.push_back({int(i), int(j), vars});
+            hasPred[j] = hasSucc[i] = true;
+        }
+    }
+
+    auto barrierNode = [&](std::size_t k) { return k < nbBarriers ? int(nbTasks + k) : end; };
+
+    std::vector<bool> emptySegment(nbBarriers + 1, true);
+    for (std::size_t i = 0; i < nbTasks; ++i) {
+        emptySegment[segment[i]] = false;
+        if (!hasPred[i] && segment[i] > 0) graph.edges.push_back({barrierNode(segment[i] - 1), int(i), ""});
+        if (!hasSucc[i]) graph.edges.push_back({int(i), barrierNode(segment[i]), ""});
+    }
+    for (std::size_t k = 1; k <= nbBarriers; ++k) {
+        if (emptySegment[k]) graph.edges.push_back({barrierNode(k - 1), barrierNode(k), ""});
+    }
+
+    /* creation order is a topological order */
+    std::vector<int> order;
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < nbTasks; ++i) {
+        for (; k < segment[i]; ++k) order.push_back(barrierNode(k));
+        order.push_back(i);
+    }
+    for (; k <= nbBarriers; ++k) order.push_back(barrierNode(k));
+
+    std::vector<std::vector<int>> preds(graph.nodes.size());
+    for (const TaskGraph::Edge &edge : graph.edges) {
+        preds[edge.to].push_back(edge.from);
+    }
+
+    std::vector<uint64_t> finish(graph.nodes.size(), 0);
+    std::vector<int> longest(graph.nodes.size(), -1);
+
+    for (int v : order) {
+        for (int u : preds[v]) {
+            if (longest[v] < 0 || finish[u] > finish[longest[v]]) longest[v] = u;
+        }
+        finish[v] = (longest[v] < 0 ? 0 : finish[longest[v]]) + graph.nodes[v].cost;
+        graph.work += graph.nodes[v].cost;
+    }
+
+    graph.span = finish[end];
+    for (int v = end; v >= 0; v = longest[v]) {
+        graph.criticalPath.push_back(v);
+    }
+    std::reverse(graph.criticalPath.begin(), graph.criticalPath.end());
+
+    return graph;
+}
+
+static const TaskGraph::Edge *
+findEdge(const TaskGraph &graph, int from, int to) {
+    for (const TaskGraph::Edge &edge : graph.edges) {
+        if (edge.from == from && edge.to == to) return &edge;
+    }
+    return nullptr;
+}
+
+static double
+getParallelism(const TaskGraph &graph) {
+    return graph.span ? double(graph.work) / graph.span : 1.0;
+}
+
+/* `a (line 3) -[x]-> b (line 5) -> end`, naming the variables of the dependencies on the way */
+static std::string
+getCriticalPathText(const TaskGraph &graph) {
+    std::string text;
+
+    for (std::size_t i = 0; i < graph.criticalPath.size(); ++i) {
+        if (i > 0) {
+            const TaskGraph::Edge *edge = findEdge(graph, graph.criticalPath[i - 1], graph.criticalPath[i]);
+            text += edge && !edge->vars.empty() ? " -[" + edge->vars + "]-> " : " -> ";
+        }
+        text += getNodeName(graph.nodes[graph.criticalPath[i]]);
+    }
+
+    return text;
+}
+
+static void
+writeDot(llvm::raw_ostream &OS, const TaskGraph &graph, int id) {
+    std::string prefix = "f" + std::to_string(id) + "_";
+    std::set<std::pair<int, int>> critical;
+    for (std::size_t i = 1; i < graph.criticalPath.size(); ++i) {
+        critical.insert({graph.criticalPath[i - 1], graph.criticalPath[i]});
+    }
+
+    OS << "    subgraph cluster_" << id << " {\n"
+       << "        label=\"" << escape(graph.function) << ": work " << graph.work << ", span " << graph.span
+       << ", parallelism " << llvm::format("%.2f", getParallelism(graph)) << "\";\n";
+
+    for (std::size_t v = 0; v < graph.nodes.size(); ++v) {
+        const TaskGraph::Node &node = graph.nodes[v];
+        bool onPath = std::find(graph.criticalPath.begin(), graph.criticalPath.end(), int(v)) != graph.criticalPath.end();
+
+        OS << "        " << prefix << v << " [label=\"" << escape(getNodeName(node));
+        if (node.kind == TaskGraph::Node::Call) OS << "\\ncost " << node.cost;
+        OS << "\"";
+        if (node.kind == TaskGraph::Node::Wait) OS << ", shape=octagon";
+        if (node.kind == TaskGraph::Node::End) OS << ", shape=doublecircle";
+        if (onPath) OS << ", color=red";
+        OS << "];\n";
+    }
+
+    for (const TaskGraph::Edge &edge : graph.edges) {
+        OS << "        " << prefix << edge.from << " -> " << prefix << edge.to << " [";
+        OS << (edge.vars.empty() ? "style=dashed" : "label=\"" + escape(edge.vars) + "\"");
+        if (critical.count({edge.from, edge.to})) OS << ", color=red, penwidth=2";
+        OS << "];\n";
+    }
+
+    OS << "    }\n";
+}
+
+static llvm::json::Object
+toJSON(const TaskGraph &graph) {
+    llvm::json::Array nodes, edges, path;
+
+    for (std::size_t v = 0; v < graph.nodes.size(); ++v) {
+        const TaskGraph::Node &node = graph.nodes[v];
+        llvm::json::Object object{{"id", int64_t(v)}, {"kind", getKindName(node.kind)}};
+        if (node.kind != TaskGraph::Node::End) {
+            object["line"] = node.line;
+        }
+        if (node.kind == TaskGraph::Node::Call) {
+            object["callee"] = node.label;
+            object["cost"] = node.cost;
+        }
+        nodes.push_back(std::move(object));
+    }
+
+    for (const TaskGraph::Edge &edge : graph.edges) {
+        llvm::json::Object object{{"from", edge.from}, {"to", edge.to}, {"kind", edge.vars.empty() ? "barrier" : "depend"}};
+        if (!edge.vars.empty()) {
+            object["vars"] = edge.vars;
+        }
+        edges.push_back(std::move(object));
+    }
+
+    for (int v : graph.criticalPath) {
+        path.push_back(v);
+    }
+
+    return llvm::json::Object{
+        {"name", graph.function},
+        {"work", graph.work},
+        {"span", graph.span},
+        {"parallelism", getParallelism(graph)},
+        {"criticalPath", std::move(path)},
+        {"nodes", std::move(nodes)},
+        {"edges", std::move(edges)},
+    };
+}
+
+/* <dir>/<file>.dot with a cluster per taskgroup function, and the same graphs in <dir>/<file>.json */
+bool
+writeTaskGraphs(StringRef mainFile, const std::vector<Function> &functions) {
+    if (llvm::sys::fs::create_directories(TaskGraphDir)) {
+        llvm::errs() << "Error creating task graph directory: " << TaskGraphDir << "\n";
+        return false;
+    }
+
+    StringRef fileName = llvm::sys::path::filename(mainFile);
+    llvm::SmallString<256> path(TaskGraphDir);
+    llvm::sys::path::append(path, fileName);
+
+    std::error_code EC;
+    llvm::raw_fd_ostream dotFile((path + ".dot").str(), EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+        llvm::errs() << "Error opening file for writing: " << path << ".dot\n";
+        return false;
+    }
+
+    llvm::raw_fd_ostream jsonFile((path + ".json").str(), EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+        llvm::errs() << "Error opening file for writing: " << path << ".json\n";
+        return false;
+    }
+
+    llvm::json::Array graphs;
+    dotFile << "digraph \"" << escape(fileName.str()) << "\" {\n"
+            << "    node [shape=box];\n";
+
+    for (const Function &function : functions) {
+        if (function.tasks.empty()) continue;
+
+        TaskGraph graph = buildTaskGraph(function);
+        llvm::outs() << "Task graph: " << graph.function << ": work " << graph.work << ", span " << graph.span
+                     << ", parallelism " << llvm::format("%.2f", getParallelism(graph))
+                     << ", critical path " << getCriticalPathText(graph) << "\n";
+
+        writeDot(dotFile, graph, function.id);
+        graphs.push_back(toJSON(graph));
+    }
+
+    dotFile << "}\n";
+
+    llvm::json::OStream J(jsonFile, 2);
+    J.value(llvm::json::Object{{"file", fileName}, {"functions", std::move(graphs)}});
+    jsonFile << "\n";
+
+    return true;
+}
@@ -0,0 +1,125 @@
+#include <task_profile.hpp>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+/* sites are matched by full path, files of the same name in different directories are different sites */
+static std::tuple<std::string, unsigned, unsigned>
+getKey(StringRef file, unsigned line, unsigned column) {
+    return {getSitePath(file), line, column};
+}
+
+
+/* PUBLICS */
+
+
+TaskProfile &TaskProfile::get() {
+    static TaskProfile profile;
+    return profile;
+}
+
+bool TaskProfile::load(StringRef path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        llvm::errs() << "Error reading task profile " << path << ": " << buffer.getError().message() << "\n";
+        return false;
+    }
+
+    auto json = llvm::json::parse((*buffer)->getBuffer());
+    if (!json) {
+        llvm::errs() << "Error parsing task profile " << path << ": " << llvm::toString(json.takeError()) << "\n";
+        return false;
+    }
+
+    const llvm::json::Object *root = json->getAsObject();
+    const llvm::json::Array *entries = root ? root->getArray("sites") : nullptr;
+    if (!entries) {
+        llvm::errs() << "Error parsing task profile " << path << ": missing \"sites\"\n";
+        return false;
+    }
+
+    for (const auto &value : *entries) {
+        const llvm::json::Object *object = value.getAsObject();
+        if (!object || object->getString("kind").value_or("") != "task") continue;
+
+        SiteProfile site;
+        site.callee = object->getString("callee").value_or("").str();
+        site.file = object->getString("file").value_or("").str();
+        site.line = object->getInteger("line").value_or(0);
+        site.column = object->getInteger("column").value_or(0);
+        site.created = object->getInteger("created").value_or(0);
+        site.inlined = object->getInteger("inlined").value_or(0);
+
+        if (const llvm::json::Array *depths = object->getArray("depths")) {
+            for (const auto &depth : *depths) {
+                const llvm::json::Array *pair = depth.getAsArray();
+                if (!pair || pair->size() != 2) break;
+
+                site.depths.emplace_back((*pair)[0].getAsInteger().value_or(0), (*pair)[1].getAsNumber().value_or(0));
+            }
+        }
+
+        /* profiles of several runs of the same build are accumulated */
+        SiteProfile &merged = sites[getKey(site.file, site.line, site.column)];
+        if (merged.file.empty()) {
+            merged = std::move(site);
+            continue;
+        }
+
+        merged.created += site.created;
+        merged.inlined += site.inlined;
+        if (merged.depths.size() < site.depths.size()) {
+            merged.depths.resize(site.depths.size());
+        }
+        for (size_t i = 0; i < site.depths.size(); ++i) {
+            merged.depths[i].first += site.depths[i].first;
+            merged.depths[i].second += site.depths[i].second;
+        }
+    }
+
+    return true;
+}
+
+const SiteProfile *TaskProfile::lookup(StringRef file, unsigned line, unsigned column) const {
+    auto it = sites.find(getKey(file, line, column));
+    return it == sites.end() ? nullptr : &it->second;
+}
+
+/*
+tasks deeper in the recursion are smaller, so the cutoff is the first spawning depth at which tasks
+take on average less than `minTaskNs`; a site whose shallowest tasks are already too small is serialized
+*/
+SiteDecision
+decideSite(const SiteProfile &site, double minTaskNs) {
+    SiteDecision decision;
+    bool shallowest = true;
+
+    for (unsigned depth = 0; depth < site.depths.size(); ++depth) {
+        unsigned long long count = site.depths[depth].first;
+        if (count == 0) continue;
+
+        if (site.depths[depth].second / count < minTaskNs) {
+            decision.kind = shallowest ? SiteDecision::Serialize : SiteDecision::Cutoff;
+            decision.depth = depth;
+            return decision;
+        }
+
+        shallowest = false;
+    }
+
+    return decision;
+}
+
+std::string
+getSitePath(StringRef file) {
+    if (file.empty()) return "";
+
+    llvm::SmallString<256> path(file);
+    llvm::sys::fs::make_absolute(path);
+    llvm::sys::path::remove_dots(path, true);
+    return path.str().str();
+}
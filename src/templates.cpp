@@ -0,0 +1,140 @@
+#include <templates.hpp>
+
+#include <clang/AST/DeclTemplate.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <llvm/ADT/APSInt.h>
+#include <llvm/Support/Casting.h>
+#include <algorithm>
+
+static std::pair<unsigned, unsigned>
+getKey(const CallExpr *FCall) {
+    return {FCall->getBeginLoc().getRawEncoding(), FCall->getEndLoc().getRawEncoding()};
+}
+
+class InstantiationCollector : public RecursiveASTVisitor<InstantiationCollector> {
+public:
+    InstantiationCollector(std::map<std::pair<unsigned, unsigned>, std::vector<InstantiatedCall>> &calls)
+        : calls(calls) {}
+
+    bool shouldVisitTemplateInstantiations() const { return true; }
+
+    bool VisitFunctionDecl(FunctionDecl *FD) {
+        if (FD->isTemplateInstantiation() && FD->doesThisDeclarationHaveABody()) {
+            collect(FD->getBody(), FD);
+        }
+        return true;
+    }
+
+private:
+    std::map<std::pair<unsigned, unsigned>, std::vector<InstantiatedCall>> &calls;
+
+    void collect(const Stmt *s, const FunctionDecl *FD) {
+        if (!s) return;
+
+        if (const auto *FCall = llvm::dyn_cast<CallExpr>(s)) {
+            const auto *memberCall = llvm::dyn_cast<CXXMemberCallExpr>(FCall);
+            bool conversion = memberCall && llvm::isa_and_nonnull<CXXConversionDecl>(memberCall->getMethodDecl());
+
+            /* implicit conversions share the range of the expression they convert */
+            if (!conversion && FCall->getBeginLoc().isValid()) {
+                auto &instances = calls[getKey(FCall)];
+                bool seen = std::any_of(instances.begin(), instances.end(),
+                                        [FD](const InstantiatedCall &c) { return c.function == FD; });
+                if (!seen) {
+                    instances.push_back({FCall, FD});
+                }
+            }
+        }
+
+        for (const Stmt *Child : s->children()) {
+            collect(Child, FD);
+        }
+    }
+};
+
+/* compile-time condition matching the template arguments of one function template instantiation */
+static std::string
+getInstantiationCondition(const FunctionDecl *FD) {
+    const FunctionTemplateDecl *FTD = FD->getPrimaryTemplate();
+    const TemplateArgumentList *args = FD->getTemplateSpecializationArgs();
+
+    if (!FTD || !args) return "";
+
+    const TemplateParameterList *params = FTD->getTemplateParameters();
+    if (params->size() != args->size()) return "";
+
+    const PrintingPolicy &policy = FD->getASTContext().getPrintingPolicy();
+    std::string condition;
+
+    for (unsigned i = 0; i < params->size(); ++i) {
+        const NamedDecl *param = params->getParam(i);
+        const TemplateArgument &arg = args->get(i);
+
+        if (!param->getIdentifier() || param->isParameterPack()) return "";
+
+        std::string test;
+        if (arg.getKind() == TemplateArgument::Type) {
+            std::string type = arg.getAsType().getAsString(policy);
+            if (type.find('(') != std::string::npos) return ""; /* anonymous and local types cannot be named */
+            test = "std::is_same_v<" + param->getNameAsString() + ", " + type + ">";
+        } else if (arg.getKind() == TemplateArgument::Integral) {
+            test = "(" + param->getNameAsString() + " == " + llvm::toString(arg.getAsIntegral(), 10) + ")";
+        } else {
+            return "";
+        }
+
+        condition += condition.empty() ? test : " && " + test;
+    }
+
+    return "(" + condition + ")";
+}
+
+
+/* PUBLICS */
+
+
+InstantiationIndex &InstantiationIndex::get() {
+    static InstantiationIndex index;
+    return index;
+}
+
+void InstantiationIndex::build(ASTContext &AC) {
+    calls.clear();
+
+    InstantiationCollector collector(calls);
+    collector.TraverseDecl(AC.getTranslationUnitDecl());
+}
+
+const std::vector<InstantiatedCall> *InstantiationIndex::lookup(const CallExpr *FCall) const {
+    auto it = calls.find(getKey(FCall));
+    return it == calls.end() ? nullptr : &it->second;
+}
+
+/*
+condition for `if constexpr` selecting the instantiations in which a call is taskified,
+empty when the instantiations cannot be told apart by their template arguments
+*/
+std::string
+getInstantiationGuard(const std::vector<const FunctionDecl *> &tasks, const std::vector<const FunctionDecl *> &serial) {
+    std::vector<std::string> taskConditions;
+    std::string guard;
+
+    for (const FunctionDecl *FD : tasks) {
+        std::string condition = getInstantiationCondition(FD);
+        if (condition.empty()) return "";
+
+        taskConditions.push_back(condition);
+        guard += guard.empty() ? condition : " || " + condition;
+    }
+
+    for (const FunctionDecl *FD : serial) {
+        std::string condition = getInstantiationCondition(FD);
+        if (condition.empty()
+            || std::find(taskConditions.begin(), taskConditions.end(), condition) != taskConditions.end()) {
+            return "";
+        }
+    }
+
+    return guard;
+}
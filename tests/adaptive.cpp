@@ -0,0 +1,20 @@
+// RUN: --adaptive
+// ENV: AUTOPAR_TUNE_LOG=1
+// CHECK: Parallelizing fib
+// CHECK: static AUTOPAR_Tuner AUTOPAR_tuner;
+// CHECK: AUTOPAR_TuneScope AUTOPAR_tscope(AUTOPAR_tuner);
+#include <cstdio>
+
+long fib(int n) {
+    if (n < 2) return n;
+    long a = fib(n - 1);
+    long b = fib(n - 2);
+    return a + b;
+}
+
+int main() {
+    for (int n = 10; n < 25; ++n) {
+        long value = fib(n);
+        std::printf("%d %ld\n", n, value);
+    }
+}
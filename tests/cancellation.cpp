@@ -0,0 +1,31 @@
+// RUN: --cancel
+// ENV: OMP_CANCELLATION=true
+// CHECK: Cancellation: find cancels its pending tasks when returning at line 20, 22, which needs OMP_CANCELLATION=true at run time
+// CHECK: #pragma omp taskwait depend(in: a)
+// CHECK: AUTOPAR_CancelTaskgroup();
+#include <cstdio>
+
+long search(const long *data, long n, long key) {
+    for (long i = 0; i < n; ++i) {
+        if (data[i] == key) return i;
+    }
+    return -1;
+}
+
+/* the second half is not needed once the key is found in the first one */
+long find(const long *data, long n, long key) {
+    long a = search(data, n / 2, key);
+    long b = search(data + n / 2, n - n / 2, key);
+    if (a >= 0) {
+        return a;
+    }
+    return b >= 0 ? n / 2 + b : -1;
+}
+
+int main() {
+    static long data[100000];
+    for (long i = 0; i < 100000; ++i) {
+        data[i] = i * 3;
+    }
+    std::printf("%ld %ld %ld\n", find(data, 100000, 300), find(data, 100000, 270000), find(data, 100000, 7));
+}
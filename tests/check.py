@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+Regression check of one sample, run by `ctest`.
+
+The first comment lines of a sample tell how it is checked:
+
+    // RUN: <autopar options>
+    // ENV: <VARIABLE>=<value>          environment of the parallel binary
+    // FLAGS: <compiler options>        added to both builds, e.g. sanitizers
+    // CHECK: <text>                    must appear in the log of autopar or in its output
+    // CHECK-NOT: <text>                must appear in neither
+
+The sample is transformed with the options of its RUN line, then compiled as is (serial) and after
+going through autopar (parallel) against autopar_rt. Both binaries must exit successfully and print the
+same thing, numbers being compared with a relative tolerance.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+
+DIRECTIVES = ("RUN", "ENV", "FLAGS", "CHECK", "CHECK-NOT")
+
+
+def parse_directive(line):
+    line = line.strip()
+    if not line.startswith("//"):
+        return None, None
+    key, _, value = line[2:].strip().partition(": ")
+    return (key, value.strip()) if key in DIRECTIVES else (None, None)
+
+
+def read_directives(sample):
+    directives = {key: [] for key in DIRECTIVES}
+    with open(sample) as f:
+        for line in f:
+            if not line.strip().startswith("//"):
+                break
+            key, value = parse_directive(line)
+            if key:
+                directives[key].append(value)
+    return directives
+
+
+def build(command):
+    print("+ " + " ".join(command), flush=True)
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    sys.stdout.write(result.stdout)
+    if result.returncode != 0:
+        sys.exit("command failed with exit code {}".format(result.returncode))
+    return result.stdout
+
+
+def run(binary, env):
+    result = subprocess.run([binary], env=env, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    if result.returncode != 0:
+        sys.exit("{} failed with exit code {}:\n{}".format(binary, result.returncode, result.stderr))
+    return result.stdout
+
+
+def same_output(expected, actual, tolerance):
+    expected, actual = expected.split(), actual.split()
+    if len(expected) != len(actual):
+        return False
+
+    for a, b in zip(expected, actual):
+        if a == b:
+            continue
+        try:
+            x, y = float(a), float(b)
+        except ValueError:
+            return False
+        if abs(x - y) > tolerance * max(abs(x), abs(y)):
+            return False
+
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("sample")
+    parser.add_argument("--autopar", required=True)
+    parser.add_argument("--clang-flags", default="", help="extra options of the clang frontend of autopar, e.g. -resource-dir=<dir>")
+    parser.add_argument("--runtime-include", required=True)
+    parser.add_argument("--runtime-lib", required=True)
+    parser.add_argument("--cxx", default="c++")
+    parser.add_argument("--cxx-flags", default="-O1 -std=c++17")
+    parser.add_argument("--openmp-flags", default="-fopenmp")
+    parser.add_argument("--threads", default="4")
+    parser.add_argument("--tolerance", type=float, default=1e-9)
+    parser.add_argument("--work-dir", default="tests")
+    args = parser.parse_args()
+
+    directives = read_directives(args.sample)
+    name = os.path.splitext(os.path.basename(args.sample))[0]
+    work_dir = os.path.join(args.work_dir, name)
+    output = os.path.join(work_dir, os.path.basename(args.sample))
+    serial = os.path.join(work_dir, name + "_serial")
+    parallel = os.path.join(work_dir, name + "_autopar")
+    os.makedirs(work_dir, exist_ok=True)
+
+    options = " ".join(directives["RUN"]).split()
+    log = build([args.autopar] + options + ["--output-dir=" + work_dir, args.sample, "--",
+                                            "-std=c++17", "-I" + args.runtime_include] + args.clang_flags.split())
+    with open(output) as f:
+        text = log + "".join(line for line in f if not parse_directive(line)[0])
+
+    failed = False
+    for expected in directives["CHECK"]:
+        if expected not in text:
+            print("CHECK failed: " + expected)
+            failed = True
+    for unexpected in directives["CHECK-NOT"]:
+        if unexpected in text:
+            print("CHECK-NOT failed: " + unexpected)
+            failed = True
+
+    flags = args.cxx_flags.split() + args.openmp_flags.split() + " ".join(directives["FLAGS"]).split()
+    build([args.cxx] + flags + [args.sample, "-o", serial])
+    build([args.cxx] + flags + ["-I" + args.runtime_include, output, args.runtime_lib, "-o", parallel])
+
+    env = dict(os.environ, OMP_NUM_THREADS=args.threads)
+    for variable in directives["ENV"]:
+        key, _, value = variable.partition("=")
+        env[key] = value
+
+    reference = run(serial, dict(os.environ))
+    actual = run(parallel, env)
+    if not same_output(reference, actual, args.tolerance):
+        print("the parallel binary printed:\n{}instead of:\n{}".format(actual, reference))
+        failed = True
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
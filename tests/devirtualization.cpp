@@ -0,0 +1,36 @@
+// CHECK: Parallelizing total
+// CHECK: typeid(a) == typeid(Square)
+// CHECK: typeid(a) == typeid(Rectangle)
+// CHECK: typeid(b) == typeid(Square)
+#include <cstdio>
+
+struct Shape {
+    virtual ~Shape() = default;
+    virtual long area(int scale) const = 0;
+};
+
+struct Square : Shape {
+    long side;
+    explicit Square(long side) : side(side) {}
+    long area(int scale) const override { return side * side * scale; }
+};
+
+struct Rectangle : Shape {
+    long width;
+    long height;
+    Rectangle(long width, long height) : width(width), height(height) {}
+    long area(int scale) const override { return width * height * scale; }
+};
+
+long total(const Shape &a, const Shape &b) {
+    long x = a.area(2);
+    long y = b.area(3);
+    return x + y;
+}
+
+int main() {
+    Square square(3);
+    Rectangle rectangle(2, 5);
+    long area = total(square, rectangle);
+    std::printf("%ld\n", area);
+}
@@ -0,0 +1,41 @@
+// CHECK: Parallelizing fib
+// CHECK: Parallelizing combine
+// CHECK: Decomposing 2 nested calls at line 29
+// CHECK: Pure: reusing sq(n) of line 30 for z at line 31
+// CHECK: AUTOPAR_endtaskgrouplabel_fib: ;
+#include <cstdio>
+
+/* the returns before the declarations of task results jump out of their scope */
+long fib(int n) {
+    if (n < 2) return n;
+    long a = fib(n - 1);
+    long b = fib(n - 2);
+    return a + b;
+}
+
+long sq(long x) {
+    return x * x;
+}
+
+long add(long a, long b) {
+    return a + b;
+}
+
+/* a decomposed declaration and a reused pure call after an early return */
+long combine(long n) {
+    if (n < 0) {
+        return 0;
+    }
+    long x = add(sq(n), sq(n + 1));
+    long y = sq(n);
+    long z = sq(n);
+    return x + y + z;
+}
+
+int main() {
+    long total = 0;
+    for (long n = -2; n < 100; ++n) {
+        total += combine(n);
+    }
+    std::printf("%ld %ld\n", fib(25), total);
+}
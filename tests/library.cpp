@@ -0,0 +1,31 @@
+// RUN: --library
+// CHECK: Library: twoDots starts a team when called outside of a parallel region
+// CHECK: AUTOPAR_InTeam([&] {
+// CHECK-NOT: Parallelizing main
+#include <cstdio>
+
+long dot(const long *a, const long *b, long n) {
+    long sum = 0;
+    for (long i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+long twoDots(const long *a, const long *b, long n) {
+    long x = dot(a, b, n / 2);
+    long y = dot(a + n / 2, b + n / 2, n - n / 2);
+    return x + y;
+}
+
+/* called through a pointer, as by a user of the library, so that main creates no team of its own */
+int main() {
+    static long a[100000];
+    static long b[100000];
+    for (long i = 0; i < 100000; ++i) {
+        a[i] = i % 7;
+        b[i] = i % 11;
+    }
+    long (*entry)(const long *, const long *, long) = twoDots;
+    std::printf("%ld\n", entry(a, b, 100000));
+}
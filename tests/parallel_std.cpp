@@ -0,0 +1,31 @@
+// RUN: --parallel-std --parallel-std-min-size=1000
+// CHECK: Parallel std: std::sort at line 21 runs in tasks
+// CHECK: Parallel std: std::accumulate at line 22 runs in tasks
+// CHECK: Parallel std: rejected std::accumulate at line 28: accumulating double in a different order changes the result
+// CHECK: AUTOPAR_ParallelSort<1000>(values.begin(), values.end());
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+int main() {
+    std::vector<long> values(100000);
+    std::vector<double> weights(100000);
+
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = (i * 7919) % values.size();
+    }
+    for (std::size_t i = 0; i < weights.size(); ++i) {
+        weights[i] = 1.0 / (i + 1);
+    }
+    std::sort(values.begin(), values.end());
+    long sum = std::accumulate(values.begin(), values.end(), 0L);
+
+    long sorted = 1;
+    for (std::size_t i = 1; i < values.size(); ++i) {
+        sorted &= values[i - 1] <= values[i];
+    }
+    double harmonic = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+    std::printf("%ld %ld %.17g\n", sorted, sum, harmonic);
+}
@@ -0,0 +1,42 @@
+// FLAGS: -fsanitize=address -g
+// CHECK: Parallelizing run
+// CHECK: AUTOPAR_Slot<Label> AUTOPAR_slot_unused;
+// CHECK: Label &unused = AUTOPAR_slot_unused.get()
+// CHECK: AUTOPAR_SlotScope<Label> AUTOPAR_scope_unused(AUTOPAR_slot_unused);
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+/* labels alive, the end of each iteration destroys its own */
+std::atomic<int> live{0};
+
+/* long enough not to fit in the string itself, so that a use after destruction touches the heap */
+struct Label {
+    std::string text;
+
+    explicit Label(int i) : text("a label longer than the small string buffer " + std::to_string(i)) { ++live; }
+    Label(const Label &other) : text(other.text) { ++live; }
+    ~Label() { --live; }
+};
+
+Label label(int i) {
+    return Label(i);
+}
+
+void count(int i, long *total) {
+    *total += i;
+}
+
+long run(int n) {
+    long total = 0;
+    for (int i = 0; i < n; ++i) {
+        Label unused = label(i);
+        count(i, &total);
+    }
+    std::printf("%d labels left after the loop\n", live.load());
+    return total;
+}
+
+int main() {
+    std::printf("%ld\n", run(1000));
+}
@@ -0,0 +1,36 @@
+// RUN: --simd
+// CHECK: SIMD: vectorized loop at line 17
+// CHECK: SIMD: vectorized loop at line 21
+// CHECK: SIMD: vectorized loop at line 25
+// CHECK: #pragma omp simd reduction(+: sum)
+// CHECK: SIMD: rejected loop at line 28: a depends on the previous iteration
+// CHECK: SIMD: rejected loop at line 31: b depends on the previous iteration
+#include <cstdio>
+
+constexpr int N = 1000;
+
+int main() {
+    long a[N];
+    long b[N];
+    long c[N];
+
+    for (int i = 0; i < N; ++i) {
+        a[i] = i;
+        b[i] = 2 * i;
+    }
+    for (int i = 0; i < N; ++i) {
+        c[i] = a[i] + b[i];
+    }
+    long sum = 0;
+    for (int i = 0; i < N; ++i) {
+        sum += c[i];
+    }
+    for (int i = 1; i < N; ++i) {
+        a[i] = a[i - 1] + c[i];
+    }
+    for (int i = 0; i < N - 1; ++i) {
+        long &d = b[i + 1];
+        d = b[i] * 2;
+    }
+    std::printf("%ld %ld %ld\n", sum, a[N - 1], b[N - 1]);
+}
@@ -0,0 +1,44 @@
+// RUN: --soa
+// CHECK: SoA: converted System::particles (Particle)
+// CHECK: SoA: cannot convert Swarm::particles: an element is bound to a reference at line 41
+// CHECK: struct AUTOPAR_SoA_Particle {
+// CHECK: AUTOPAR_SoA_Particle particles;
+#include <cstdio>
+#include <vector>
+
+struct Particle {
+    long x;
+    long v;
+};
+
+struct System {
+    std::vector<Particle> particles;
+};
+
+struct Swarm {
+    std::vector<Particle> particles;
+};
+
+int main() {
+    System s;
+    for (long i = 0; i < 1000; ++i) {
+        s.particles.push_back(Particle{i, 2 * i});
+    }
+    for (std::size_t i = 0; i < s.particles.size(); ++i) {
+        s.particles[i].x += s.particles[i].v;
+    }
+    long sum = 0;
+    for (std::size_t i = 0; i < s.particles.size(); ++i) {
+        Particle p = s.particles[i];
+        sum += p.x;
+    }
+
+    Swarm w;
+    w.particles.push_back(Particle{1, 2});
+    for (int i = 0; i < 10; ++i) {
+        w.particles[0].x += w.particles[0].v;
+    }
+    const Particle &first = w.particles[0];
+    w.particles[0].x = 0;
+    std::printf("%ld %ld\n", sum, first.x);
+}
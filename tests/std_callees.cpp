@@ -0,0 +1,34 @@
+// CHECK: Parallelizing total
+// CHECK-NOT: Parallelizing largest
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+long sum(const std::vector<long> &v, std::size_t begin, std::size_t end) {
+    long s = 0;
+    for (std::size_t i = begin; i < end; ++i) {
+        s += v[i];
+    }
+    return s;
+}
+
+long total(const std::vector<long> &v) {
+    long a = sum(v, 0, v.size() / 2);
+    long b = sum(v, v.size() / 2, v.size());
+    return a + b;
+}
+
+/* calls only functions of the standard library, none of which becomes a task */
+long largest(std::vector<long> v) {
+    std::sort(v.begin(), v.end());
+    std::swap(v.front(), v.back());
+    return std::max(v.front(), v[v.size() / 2]);
+}
+
+int main() {
+    std::vector<long> v(1000);
+    for (std::size_t i = 0; i < v.size(); ++i) {
+        v[i] = (i * 37) % 1000;
+    }
+    std::printf("%ld %ld\n", total(v), largest(v));
+}